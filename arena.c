@@ -0,0 +1,51 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Bump allocator, see arena.h.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include <stdlib.h>
+
+#include "arena.h"
+
+bool arena_reserve(struct arena* a, size_t size)
+{
+        /* make sure *a* can hold *size* bytes, dropping whatever it was
+         * holding. The block is only reallocated when it is too small.
+         */
+        char* base;
+
+        a->used = 0;
+        if (a->size >= size)
+                return true;
+
+        base = malloc(size);
+        if (!base)
+                return false;
+        free(a->base);
+        a->base = base;
+        a->size = size;
+        return true;
+}
+
+void* arena_alloc(struct arena* a, size_t size)
+{
+        void* p;
+
+        size = ARENA_SIZEOF(size);
+        if (size > a->size - a->used)
+                return NULL;
+
+        p = a->base + a->used;
+        a->used += size;
+        return p;
+}
+
+void arena_release(struct arena* a)
+{
+        free(a->base);
+        a->base = NULL;
+        a->size = a->used = 0;
+}
@@ -0,0 +1,33 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * A bump allocator: one malloc'd block handed out piece by piece and given
+ * back all at once, so that a game can be set up and torn down without a
+ * malloc/free per object.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define ARENA_ALIGN 16
+
+struct arena
+{
+        char* base;
+        size_t size;
+        size_t used;
+};
+
+/* bytes taken by an allocation of *size*, alignment included */
+#define ARENA_SIZEOF(size) (((size) + ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1))
+
+void* arena_alloc(struct arena* a, size_t size);
+void arena_release(struct arena* a);
+bool arena_reserve(struct arena* a, size_t size);
+
+#endif /* ARENA_H */
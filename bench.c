@@ -0,0 +1,852 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Benchmarks, run by `make bench'. First the engine hot paths on their
+ * own, then the game screens on the render backends which need no terminal
+ * (see render.h), then the whole front-end: a session plays on a
+ * socketpair standing for the terminal, while this side types keys and
+ * times how long each one takes to come back drawn. An engine of our own,
+ * fed the same keys, tells which key draws something and when a game is
+ * over. The same keys are played again on render_direct, for the bytes it
+ * saves over ncurses, and with the raw keys of keys.h, for the time they
+ * save over wgetch().
+ *
+ * Built with `make STATS=1' it also counts the heap allocations of the
+ * game screens and the front-end once set up, i.e. playing and starting
+ * new games: there should be none, and mtbench fails if there are.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "engine.h"
+#include "hints.h"
+#include "render.h"
+#include "rng.h"
+#include "stats.h"
+#include "ui.h"
+
+#define BENCH_KEYS 20000
+#define BENCH_SEED 1
+#define SETTLE_MS 20            /* the screen is drawn after this much quiet */
+#define BURST_KEYS 16           /* a held arrow key, see burst() */
+#define PACED_KEYS 120          /* two seconds worth at UI_FPS */
+#define VIEW_SIDE 4000          /* of the large field, see bench_view() */
+#define VIEW_RUN 64             /* moves in a row in a direction, at most */
+
+#define UP "\033OA"             /* xterm, keypad transmit mode */
+#define RIGHT "\033OC"
+#define DOWN "\033OB"
+#define LEFT "\033OD"
+
+/* ---------------------------------------------------------------------------
+ * data structures definition
+ */
+struct player
+{
+        session s;
+        int fd;                 /* the session side of the socketpair */
+};
+
+struct timings
+{
+        double* t;              /* seconds, one per frame */
+        int n;
+        unsigned long bytes;
+        unsigned long max_bytes;
+};
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+static void bench_distance(void);
+static void bench_distance_batch(void);
+static void bench_hint(bool follow);
+static void bench_map_target(int height, int width);
+static void bench_new_target(void);
+static void bench_practice(int shots);
+static void bench_push_shot(void);
+static void bench_target_row(void);
+static void bench_render(const struct render_ops* render, int inputs);
+static void bench_shots(int inputs);
+static double bench_ui(int keys, int fps, const struct render_ops* render,
+                       bool raw_keys);
+static void bench_view(const struct render_ops* render, int height,
+                       int width, int inputs);
+static long burst(int fd, game_state* mirror);
+static int cmp_double(const void* a, const void* b);
+static void count_allocs(const char* name, unsigned long since);
+static long frame(int fd, const char* key, struct timings* tm);
+static unsigned long heap_allocs(void);
+static void new_game(game_state* mirror, game_conf* conf, struct rng* seeds);
+static int next_input(game_state* game, struct rng* r);
+static double now(void);
+static void* play(void* arg);
+static void random_points(point* p, int n, struct rng* r);
+static void report(const char* name, unsigned long n, double secs);
+static double report_timings(const char* name, struct timings* tm);
+static void type_keys(int fd, const char* const* keys, int n);
+/* -------------------------------------------------------------------------- */
+
+static volatile unsigned long sink;     /* keeps the results alive */
+static unsigned long steady_allocs;     /* once set up, see count_allocs() */
+static double move_latency;     /* median, of the last bench_ui() */
+
+int main(int argc, char* argv[])
+{
+        int keys = argc > 1 ? atoi(argv[1]) : BENCH_KEYS;
+        double curses_bytes, direct_bytes, wgetch_latency;
+
+        printf("engine\n");
+        bench_distance();
+        bench_distance_batch();
+        bench_target_row();
+        bench_map_target(FIELD_HEIGHT, FIELD_WIDTH);
+        bench_map_target(64, 64);
+        bench_new_target();
+        bench_push_shot();
+        bench_hint(true);
+        bench_hint(false);
+
+        printf("render backends, %d inputs\n", keys * 10);
+        bench_render(&render_null, keys * 10);
+        bench_render(&render_grid, keys * 10);
+
+        printf("gunsight moves, %d inputs\n", keys * 10);
+        bench_view(&render_null, FIELD_HEIGHT, FIELD_WIDTH, keys * 10);
+        bench_view(&render_null, VIEW_SIDE, VIEW_SIDE, keys * 10);
+        bench_view(&render_grid, FIELD_HEIGHT, FIELD_WIDTH, keys * 10);
+        bench_view(&render_grid, VIEW_SIDE, VIEW_SIDE, keys * 10);
+
+        printf("practice on %dx%d, %d inputs as the shots pile up\n",
+               VIEW_SIDE, VIEW_SIDE, keys * 10);
+        bench_shots(keys * 10);
+        bench_practice(PRACTICE_SHOTS * 3);
+
+        printf("front-end, %d keys\n", keys);
+        curses_bytes = bench_ui(keys, 0, &render_curses, false);
+        wgetch_latency = move_latency;
+        printf("front-end at %d frames/s at most, %d keys\n", UI_FPS,
+               PACED_KEYS);
+        bench_ui(PACED_KEYS, UI_FPS, &render_curses, false);
+        printf("front-end on render_direct, %d keys\n", keys);
+        direct_bytes = bench_ui(keys, 0, &render_direct, false);
+        if (curses_bytes > 0)
+                printf("  render_direct: %.1f%% of the bytes of ncurses\n",
+                       100 * direct_bytes / curses_bytes);
+        printf("front-end with raw keys, %d keys\n", keys);
+        bench_ui(keys, 0, &render_curses, true);
+        if (wgetch_latency > 0)
+                printf("  raw keys: a move takes %.1f%% of the time it "
+                       "takes with wgetch()\n",
+                       100 * move_latency / wgetch_latency);
+        return steady_allocs != 0;
+}
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long heap_allocs(void)
+{
+#ifdef MT_STATS
+        return __atomic_load_n(&ui_stats.mallocs, __ATOMIC_RELAXED);
+#else
+        return 0;
+#endif
+}
+
+static void count_allocs(const char* name, unsigned long since)
+{
+        /* the heap allocations of *name* since *since* (heap_allocs()),
+         * when counted */
+#ifdef MT_STATS
+        unsigned long n = heap_allocs() - since;
+
+        printf("  %-24s %lu heap allocations once set up%s\n", name, n,
+               n ? ", should be none" : "");
+        steady_allocs += n;
+#endif
+}
+
+static void report(const char* name, unsigned long n, double secs)
+{
+        printf("  %-24s %8.2f M/s  %8.1f ns each\n",
+               name, n / secs / 1e6, secs * 1e9 / n);
+}
+
+static void random_points(point* p, int n, struct rng* r)
+{
+        int i;
+
+        for (i=0; i<n; i++) {
+                p[i].y = rng_below(r, FIELD_HEIGHT);
+                p[i].x = rng_below(r, FIELD_WIDTH);
+        }
+}
+
+static void bench_distance(void)
+{
+        enum { N = 1 << 12, ROUNDS = 4096 };
+        point a[N], b[N];
+        struct rng r;
+        unsigned long sum = 0;
+        double t;
+        int i, k;
+
+        rng_seed(&r, BENCH_SEED);
+        random_points(a, N, &r);
+        random_points(b, N, &r);
+
+        t = now();
+        for (k=0; k<ROUNDS; k++) {
+                for (i=0; i<N; i++)
+                        sum += distance(a[i], b[(i + k) & (N-1)]);
+        }
+        t = now() - t;
+        sink = sum;
+        report("distance()", (unsigned long)N * ROUNDS, t);
+}
+
+static void bench_distance_batch(void)
+{
+        enum { N = 1 << 12, ROUNDS = 4096 };
+        static int ay[N], ax[N], by[N], bx[N];
+        static unsigned int dist[N];
+        struct rng r;
+        unsigned long sum = 0;
+        double t;
+        int i, k;
+
+        rng_seed(&r, BENCH_SEED);
+        for (i=0; i<N; i++) {
+                ay[i] = rng_below(&r, FIELD_HEIGHT);
+                ax[i] = rng_below(&r, FIELD_WIDTH);
+                by[i] = rng_below(&r, FIELD_HEIGHT);
+                bx[i] = rng_below(&r, FIELD_WIDTH);
+        }
+
+        t = now();
+        for (k=0; k<ROUNDS; k++) {
+                distance_batch(ay, ax, by, bx, dist, N);
+                sum += dist[k & (N-1)];
+        }
+        t = now() - t;
+        sink = sum;
+        report("distance_batch()", (unsigned long)N * ROUNDS, t);
+}
+
+static void bench_new_target(void)
+{
+        enum { ROUNDS = 10000000 };
+        game_state game;
+        game_conf conf;
+        unsigned long sum = 0;
+        double t;
+        point p;
+        int k;
+
+        memset(&game, 0, sizeof(game));
+        memset(&conf, 0, sizeof(conf));
+        conf.level = 1;
+        game_init(&game, &conf, FIELD_HEIGHT, FIELD_WIDTH);
+
+        t = now();
+        for (k=0; k<ROUNDS; k++) {
+                p = get_new_target(&game);
+                sum += p.y * FIELD_WIDTH + p.x;
+        }
+        t = now() - t;
+        sink = sum;
+        report("get_new_target()", ROUNDS, t);
+        game_free(&game);
+}
+
+static void bench_push_shot(void)
+{
+        enum { ROUNDS = 10000000 };
+        game_state game;
+        game_conf conf;
+        double t;
+        point p;
+        int k;
+
+        memset(&game, 0, sizeof(game));
+        memset(&conf, 0, sizeof(conf));
+        conf.level = 1;
+        game_init(&game, &conf, FIELD_HEIGHT, FIELD_WIDTH);
+
+        t = now();
+        for (k=0; k<ROUNDS; k++) {
+                if (game.shots.len == game.shots.cap)
+                        game.shots.len = 0;
+                p.y = k & 7;
+                p.x = k & 31;
+                push_shot(&game, p, k & 63, k & 3);
+        }
+        t = now() - t;
+        sink = game.shots.x[k % game.shots.cap];
+        report("push_shot()", ROUNDS, t);
+        game_free(&game);
+}
+
+static void bench_target_row(void)
+{
+        /* what the heatmap costs over a view of the field window: its 13
+         * rows of 63 cells, on a field whatever its size */
+        enum { ROUNDS = 100000 };
+        game_state game;
+        game_conf conf;
+        const unsigned int* dist;
+        unsigned long sum = 0;
+        double t;
+        int k, y;
+
+        memset(&game, 0, sizeof(game));
+        memset(&conf, 0, sizeof(conf));
+        conf.level = 1;
+        game_init(&game, &conf, 4000, 4000);
+
+        t = now();
+        for (k=0; k<ROUNDS; k++) {
+                game.target = get_new_target(&game);
+                for (y=1; y<FIELD_HEIGHT-1; y++) {
+                        dist = target_row(&game, game.target.y + y,
+                                          game.target.x, FIELD_WIDTH-2);
+                        sum += dist[k % (FIELD_WIDTH-2)];
+                }
+        }
+        t = now() - t;
+        sink = sum;
+        report("heatmap of a 13x63 view", ROUNDS, t);
+        game_free(&game);
+}
+
+static void bench_map_target(int height, int width)
+{
+        /* what a new target costs on a field keeping the maps */
+        enum { CELLS = 100000000 };
+        game_state game;
+        game_conf conf;
+        char name[32];
+        int k, rounds = CELLS / (height * width);
+        double t;
+
+        memset(&game, 0, sizeof(game));
+        memset(&conf, 0, sizeof(conf));
+        conf.level = 1;
+        game_init(&game, &conf, height, width);
+
+        t = now();
+        for (k=0; k<rounds; k++) {
+                game.target = get_new_target(&game);
+                map_target(&game);
+        }
+        t = now() - t;
+        sink = game.bucket_map[k % (height * width)];
+        sprintf(name, "map_target() %dx%d", height, width);
+        report(name, rounds, t);
+        game_free(&game);
+}
+
+static void bench_hint(bool follow)
+{
+        /* hints asked before every shot, shooting where they say (on the
+         * table all along) or anywhere (off it after the first shot) */
+        enum { GAMES = 2000 };
+        game_state game;
+        game_conf conf;
+        struct rng r;
+        unsigned long n = 0, wins = 0;
+        double t, total = 0;
+        point p;
+        int k;
+
+        memset(&game, 0, sizeof(game));
+        memset(&conf, 0, sizeof(conf));
+        conf.level = 1;
+        rng_seed(&r, BENCH_SEED);
+
+        for (k=0; k<GAMES; k++) {
+                conf.seed = rng_next64(&r);
+                game_init(&game, &conf, FIELD_HEIGHT, FIELD_WIDTH);
+                while (game.status == GAME_RUNNING) {
+                        t = now();
+                        if (!hint_next(&game, &p) || !follow)
+                                p = get_new_target(&game);
+                        total += now() - t;
+                        n++;
+                        game.gunsight = p;
+                        game_step(&game, IN_SHOOT);
+                }
+                wins += game.status == GAME_WIN;
+        }
+        sink = wins;
+        report(follow ? "hint_next() on table" : "hint_next() off table",
+               n, total);
+        if (follow)
+                printf("  %-24s %.2f shots to win, %lu of %d won\n", "",
+                       (double)n / GAMES, wins, GAMES);
+        game_free(&game);
+}
+
+static int next_input(game_state* game, struct rng* r)
+{
+        /* a move which does move, or a shot one time in five */
+        point gs = game->gunsight;
+        int input;
+
+        do {
+                input = 1 + rng_below(r, 5);
+        } while ((input == IN_UP && gs.y == 1) ||
+                 (input == IN_RIGHT && gs.x == game->width-2) ||
+                 (input == IN_DOWN && gs.y == game->height-2) ||
+                 (input == IN_LEFT && gs.x == 1));
+        return input;
+}
+
+static void bench_render(const struct render_ops* render, int inputs)
+{
+        /* the game screens drawn by *render*, inputs straight from here */
+        session* s = calloc(1, sizeof(session));
+        struct grid* g;
+        struct rng r;
+        unsigned long allocs;
+        double t;
+        int k, games = 1;
+
+        if (s == NULL) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        s->seed = BENCH_SEED;
+        rng_seed(&r, BENCH_SEED);
+        session_open(s, render);
+
+        allocs = heap_allocs();
+        t = now();
+        for (k=0; k<inputs; k++) {
+                if (session_input(s, next_input(&s->game, &r)) & EV_OVER) {
+                        session_new_game(s);
+                        games++;
+                }
+        }
+        t = now() - t;
+        count_allocs(render->name, allocs);
+
+        report(render->name, inputs, t);
+        if (render == &render_grid) {
+                g = s->render_data;
+                printf("  %-24s %.1f cells changed/frame over %d games\n",
+                       "", (double)g->cells_changed / g->frames, games);
+        }
+        session_close(s);
+        free(s);
+}
+
+static void bench_view(const struct render_ops* render, int height,
+                       int width, int inputs)
+{
+        /* the gunsight wandering over a *height* x *width* field, in runs
+         * of moves: the frames should cost the same whatever the field, as
+         * only the view is drawn. The game is set up before timing */
+        session* s = calloc(1, sizeof(session));
+        struct grid* g;
+        struct rng r;
+        char name[32];
+        int k, input = IN_UP, run = 0;
+        double t;
+
+        if (s == NULL) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        s->seed = BENCH_SEED;
+        s->field_height = height;
+        s->field_width = width;
+        rng_seed(&r, BENCH_SEED);
+        session_open(s, render);
+
+        t = now();
+        for (k=0; k<inputs; k++) {
+                if (run-- == 0) {
+                        input = IN_UP + rng_below(&r, 4);
+                        run = rng_below(&r, VIEW_RUN);
+                }
+                session_input(s, input);
+        }
+        t = now() - t;
+
+        sprintf(name, "%s %dx%d", render->name, height, width);
+        report(name, inputs, t);
+        if (render == &render_grid) {
+                g = s->render_data;
+                printf("  %-24s %.1f cells changed/frame\n", "",
+                       (double)g->cells_changed / g->frames);
+        }
+        session_close(s);
+        free(s);
+}
+
+static void bench_shots(int inputs)
+{
+        /* the frames of a practice game while the shots fired grow to
+         * hundreds of thousands, all over the field: between two rounds
+         * they are fired from here, the gunsight put in place. A round
+         * is *inputs* moves in runs, as in bench_view(), and shots */
+        static const int fired[] = {0, 1000, 10000, 100000, 500000};
+        session* s = calloc(1, sizeof(session));
+        struct rng r;
+        char name[32];
+        int k, n, input = IN_UP, run = 0;
+        double t;
+
+        if (s == NULL) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        s->seed = BENCH_SEED;
+        s->conf.level = LEVEL_PRACTICE;
+        s->field_height = VIEW_SIDE;
+        s->field_width = VIEW_SIDE;
+        rng_seed(&r, BENCH_SEED);
+        session_open(s, &render_null);
+
+        for (n=0; n<sizeof(fired)/sizeof(fired[0]); n++) {
+                while (s->game.shots.len < fired[n]) {
+                        s->game.gunsight = get_random_point(&r, VIEW_SIDE-2,
+                                                            VIEW_SIDE-2);
+                        s->game.gunsight.y++;
+                        s->game.gunsight.x++;
+                        session_input(s, IN_SHOOT);
+                }
+
+                t = now();
+                for (k=0; k<inputs; k++) {
+                        if (run-- == 0) {
+                                input = IN_UP + rng_below(&r, 5);
+                                run = input == IN_SHOOT ? 0 :
+                                        rng_below(&r, VIEW_RUN);
+                        }
+                        session_input(s, input);
+                }
+                t = now() - t;
+
+                sprintf(name, "%d shots", s->game.shots.len);
+                report(name, inputs, t);
+        }
+        session_close(s);
+        free(s);
+}
+
+static void bench_practice(int shots)
+{
+        /* two practice games of *shots* shots, more than PRACTICE_SHOTS:
+         * the first grows the room for them, the second should find it
+         * there and ask the heap for nothing, new game included */
+        session* s = calloc(1, sizeof(session));
+        struct rng r;
+        unsigned long allocs = 0;
+        double t;
+        int game, k;
+
+        if (s == NULL) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        s->seed = BENCH_SEED;
+        s->conf.level = LEVEL_PRACTICE;
+        rng_seed(&r, BENCH_SEED);
+        session_open(s, &render_null);
+
+        for (game=0; game<2; game++) {
+                if (game) {
+                        allocs = heap_allocs();
+                        session_new_game(s);
+                }
+                t = now();
+                for (k=0; k<shots; k++) {
+                        s->game.gunsight = get_random_point(&r,
+                                        FIELD_HEIGHT-2, FIELD_WIDTH-2);
+                        s->game.gunsight.y++;
+                        s->game.gunsight.x++;
+                        session_input(s, IN_SHOOT);
+                }
+                t = now() - t;
+        }
+        count_allocs("practice, second game", allocs);
+        report("practice shots", shots, t);
+        session_close(s);
+        free(s);
+}
+
+static void* play(void* arg)
+{
+        struct player* p = arg;
+        FILE* in = fdopen(p->fd, "r");
+        FILE* out = fdopen(dup(p->fd), "w");
+
+        if (session_play(&p->s, "xterm", out, in) < 0)
+                fputs("bench: no xterm terminfo\n", stderr);
+        fclose(out);
+        fclose(in);
+        return NULL;
+}
+
+static long frame(int fd, const char* key, struct timings* tm)
+{
+        /* type *key* and wait for the frame it draws: its size in bytes is
+         * returned, and the time it took added to *tm* (if not NULL) */
+        static char buf[65536];
+        struct pollfd pfd;
+        double t, t_frame;
+        long bytes = 0;
+        ssize_t n;
+
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+
+        t = now();
+        if (write(fd, key, strlen(key)) < 0)
+                return -1;
+
+        /* the probe of a slow link (see keys.h) may trail the frame of the
+         * last key in a write of its own: this key's frame is yet to come */
+        do {
+                if (poll(&pfd, 1, 1000) <= 0)
+                        return 0;
+                t_frame = now();
+                n = read(fd, buf, sizeof(buf));
+        } while (n == strlen(LINK_PROBE) &&
+                 memcmp(buf, LINK_PROBE, n) == 0);
+        t = t_frame - t;
+
+        /* the frame comes in one write, but take whatever follows too */
+        while (n > 0) {
+                bytes += n;
+                if (poll(&pfd, 1, 0) <= 0)
+                        break;
+                n = read(fd, buf, sizeof(buf));
+        }
+
+        if (tm) {
+                tm->t[tm->n++] = t;
+                tm->bytes += bytes;
+                if (bytes > tm->max_bytes)
+                        tm->max_bytes = bytes;
+        }
+        return bytes;
+}
+
+static void type_keys(int fd, const char* const* keys, int n)
+{
+        /* type *keys* one by one, untimed, each time waiting for the screen
+         * to settle: the greeting and the options are drawn by ncurses on
+         * its own, in many writes, not in a single frame */
+        char buf[4096];
+        struct pollfd pfd;
+        int i;
+
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        for (i=0; i<n; i++) {
+                if (write(fd, keys[i], strlen(keys[i])) < 0)
+                        return;
+                while (poll(&pfd, 1, SETTLE_MS) > 0 &&
+                       read(fd, buf, sizeof(buf)) > 0)
+                        ;
+        }
+}
+
+static void new_game(game_state* mirror, game_conf* conf, struct rng* seeds)
+{
+        /* what session_play() will do with the options left as they are */
+        conf->seed = rng_next64(seeds);
+        game_init(mirror, conf, FIELD_HEIGHT, FIELD_WIDTH);
+}
+
+static double bench_ui(int keys, int fps, const struct render_ops* render,
+                       bool raw_keys)
+{
+        /* the greeting, then the options as they are: the bytes per frame
+         * are returned, the median time of a move left in move_latency */
+        static const char* const greeting[] = {"x"};
+        static const char* const setup[] = {"\r", "\r", "\r", "x"};
+        static const char* const again[] = {"n", "\r", "\r", "\r", "x"};
+        static const char* const quit[] = {"u"};
+        struct player* p = calloc(1, sizeof(struct player));
+        struct timings moves, shots;
+        game_state mirror;
+        game_conf conf;
+        struct rng seeds, r;
+        pthread_t tid;
+        const char* key;
+        int sv[2], input, k, games = 1;
+        unsigned long allocs = 0;
+        long bytes;
+        double t, setup_t, frame_bytes;
+
+        if (!p || socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+                perror("bench");
+                exit(1);
+        }
+        memset(&moves, 0, sizeof(moves));
+        memset(&shots, 0, sizeof(shots));
+        moves.t = malloc(keys * sizeof(double));
+        shots.t = malloc(keys * sizeof(double));
+        if (!moves.t || !shots.t) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+
+        p->fd = sv[1];
+        p->s.seed = BENCH_SEED;
+        p->s.max_fps = fps;
+        p->s.render = render;
+        p->s.raw_keys = raw_keys;
+        pthread_create(&tid, NULL, play, p);
+
+        memset(&mirror, 0, sizeof(mirror));
+        memset(&conf, 0, sizeof(conf));
+        conf.level = 1;
+        rng_seed(&seeds, BENCH_SEED);
+        rng_seed(&r, BENCH_SEED);
+        type_keys(sv[0], greeting, 1);
+        type_keys(sv[0], setup, 4);
+        new_game(&mirror, &conf, &seeds);
+
+        t = now();
+        for (k=0; k<keys; k++) {
+                /* ncurses keeps every terminal string it formats the first
+                 * time: allocations count from the second half on */
+                if (k == keys / 2)
+                        allocs = heap_allocs();
+
+                input = next_input(&mirror, &r);
+                switch (input) {
+                case IN_UP:
+                        key = UP;
+                        break;
+                case IN_RIGHT:
+                        key = RIGHT;
+                        break;
+                case IN_DOWN:
+                        key = DOWN;
+                        break;
+                case IN_LEFT:
+                        key = LEFT;
+                        break;
+                default:
+                        key = "s";
+                        break;
+                }
+
+                if (frame(sv[0], key, input == IN_SHOOT ? &shots : &moves)
+                    <= 0) {
+                        fprintf(stderr, "bench: no frame for key %d\n", k);
+                        break;
+                }
+
+                if (game_step(&mirror, input) & EV_OVER) {
+                        /* the options screens are not timed */
+                        setup_t = now();
+                        type_keys(sv[0], again, 5);
+                        t += now() - setup_t;
+                        new_game(&mirror, &conf, &seeds);
+                        games++;
+                }
+        }
+        t = now() - t;
+        count_allocs(raw_keys ? "raw keys" : render->name, allocs);
+        bytes = burst(sv[0], &mirror);
+
+        type_keys(sv[0], quit, 1);
+        pthread_join(tid, NULL);
+        close(sv[0]);
+
+        printf("  %d frames in %.3f s over %d games: %.0f frames/s\n",
+               moves.n + shots.n, t, games, (moves.n + shots.n) / t);
+        move_latency = report_timings("move", &moves);
+        report_timings("shot", &shots);
+        if (moves.n)
+                printf("  %d moves in one read: %ld bytes, %.1f moves' "
+                       "worth\n", BURST_KEYS, bytes,
+                       bytes / ((double)moves.bytes / moves.n));
+        frame_bytes = moves.n + shots.n ?
+                (double)(moves.bytes + shots.bytes) / (moves.n + shots.n) : 0;
+
+        game_free(&mirror);
+        free(moves.t);
+        free(shots.t);
+        free(p);
+        return frame_bytes;
+}
+
+static long burst(int fd, game_state* mirror)
+{
+        /* BURST_KEYS moves of a held arrow key in a single write, away
+         * from the nearest side: the bytes it takes to draw them */
+        char keys[BURST_KEYS * sizeof(RIGHT)];
+        const char* key = RIGHT;
+        int input = IN_RIGHT;
+        struct pollfd pfd;
+        char buf[4096];
+        long bytes = 0;
+        ssize_t n;
+        int i;
+
+        if (mirror->gunsight.x > mirror->width / 2) {
+                key = LEFT;
+                input = IN_LEFT;
+        }
+        for (i=0; i<BURST_KEYS; i++) {
+                memcpy(keys + i * strlen(key), key, strlen(key));
+                game_step(mirror, input);
+        }
+        if (write(fd, keys, BURST_KEYS * strlen(key)) < 0)
+                return 0;
+
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        while (poll(&pfd, 1, SETTLE_MS) > 0 &&
+               (n = read(fd, buf, sizeof(buf))) > 0)
+                bytes += n;
+        return bytes;
+}
+
+static int cmp_double(const void* a, const void* b)
+{
+        double x = *(const double*)a, y = *(const double*)b;
+
+        return (x > y) - (x < y);
+}
+
+static double report_timings(const char* name, struct timings* tm)
+{
+        /* keystroke to flushed frame latency percentiles, and frame size:
+         * the median is returned */
+        double* t = tm->t;
+        int n = tm->n;
+
+        if (n == 0)
+                return 0;
+        qsort(t, n, sizeof(double), cmp_double);
+        printf("  %-5s latency us: p50 %6.1f  p90 %6.1f  p99 %6.1f  "
+               "max %7.1f\n", name, t[n/2] * 1e6, t[n*9/10] * 1e6,
+               t[n*99/100] * 1e6, t[n-1] * 1e6);
+        printf("  %-5s bytes/frame: avg %6.1f  max %lu\n",
+               name, (double)tm->bytes / n, tm->max_bytes);
+        return t[n/2];
+}
@@ -0,0 +1,246 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Bots and their strategies, see bot.h.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include "bot.h"
+
+/* where get_new_target() puts the target, border included */
+#define TARGET_MIN_Y 3
+#define TARGET_MAX_Y(height) ((height)-3)
+#define TARGET_MIN_X 4
+#define TARGET_MAX_X(width) ((width)-5)
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+static int bucket_of(struct bot* bot, int a, int b);
+static point cell_point(struct bot* bot, int cell);
+static point consistent_aim(struct bot* bot);
+static void learn(struct bot* bot, point shot, int bucket);
+static point random_aim(struct bot* bot);
+static void reset(struct bot* bot);
+static point split_aim(struct bot* bot);
+static long split_score(struct bot* bot, int shooter);
+static void walk(game_state* game, point to);
+/* -------------------------------------------------------------------------- */
+
+/* shoot anywhere the target could be, never twice in the same cell */
+static const struct strategy random_strategy = {"random", random_aim};
+
+/* shoot where the target could still be, after what the lamp said */
+static const struct strategy consistent_strategy = {
+        "consistent", consistent_aim
+};
+
+/* shoot where the lamp will tell the most: the candidate cell leaving the
+ * fewest candidates on average, whatever it lights */
+static const struct strategy split_strategy = {"split", split_aim};
+
+const struct strategy* const strategies[] = {
+        &random_strategy,
+        &consistent_strategy,
+        &split_strategy,
+        NULL,
+};
+
+void bot_init(struct bot* bot, const struct strategy* strategy,
+              int height, int width)
+{
+        /* set up *bot* to play *strategy* on fields of *height*, *width* */
+        size_t cells = (size_t)height * width;
+        point o, p;
+        long score, best = LONG_MAX;
+        int i;
+
+        memset(bot, 0, sizeof(struct bot));
+        bot->strategy = strategy;
+        bot->height = height;
+        bot->width = width;
+        bot->bucket_at = malloc(cells);
+        bot->cand = malloc(cells * sizeof(int));
+        bot->shot = malloc(cells);
+        if (!bot->bucket_at || !bot->cand || !bot->shot) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+
+        /* the lamp only depends on how far the shot is on each axis */
+        o.y = o.x = 0;
+        for (p.y=0; p.y<height; p.y++) {
+                for (p.x=0; p.x<width; p.x++)
+                        bot->bucket_at[p.y * width + p.x] =
+                                distance_bucket(distance(o, p));
+        }
+
+        reset(bot);
+        bot->n_start = bot->n_cand;
+
+        /* with nothing known yet the best first shot is always the same */
+        if (strategy == &split_strategy) {
+                for (i=0; i<bot->n_start; i++) {
+                        score = split_score(bot, bot->cand[i]);
+                        if (score < best) {
+                                best = score;
+                                bot->opening = cell_point(bot, bot->cand[i]);
+                        }
+                }
+        }
+}
+
+void bot_free(struct bot* bot)
+{
+        free(bot->bucket_at);
+        free(bot->cand);
+        free(bot->shot);
+}
+
+int bot_play(struct bot* bot, game_state* game, uint64_t seed)
+{
+        /* play *game*, just started by game_init(), to its end: the shots
+         * fired are returned, game->status tells if they won. *seed* is
+         * for the choices of the bot */
+        point aim;
+
+        rng_seed(&bot->rng, seed);
+        reset(bot);
+        while (game->status == GAME_RUNNING) {
+                aim = bot->strategy->aim(bot);
+                walk(game, aim);
+                game_step(game, IN_SHOOT);
+                learn(bot, aim, game->shots.bucket[game->shots.len-1]);
+        }
+        return game->shots.len;
+}
+
+static void walk(game_state* game, point to)
+{
+        /* move the gunsight to *to*, a key at a time */
+        point* gs = &game->gunsight;
+
+        while (gs->y < to.y)
+                game_step(game, IN_DOWN);
+        while (gs->y > to.y)
+                game_step(game, IN_UP);
+        while (gs->x < to.x)
+                game_step(game, IN_RIGHT);
+        while (gs->x > to.x)
+                game_step(game, IN_LEFT);
+}
+
+static void reset(struct bot* bot)
+{
+        /* a new game: the target can be anywhere it is ever put */
+        int y, x;
+
+        bot->n_cand = 0;
+        for (y=TARGET_MIN_Y; y<=TARGET_MAX_Y(bot->height); y++) {
+                for (x=TARGET_MIN_X; x<=TARGET_MAX_X(bot->width); x++)
+                        bot->cand[bot->n_cand++] = y * bot->width + x;
+        }
+        memset(bot->shot, 0, bot->height * bot->width);
+        bot->shots = 0;
+}
+
+static point cell_point(struct bot* bot, int cell)
+{
+        point p;
+
+        p.y = cell / bot->width;
+        p.x = cell % bot->width;
+        return p;
+}
+
+static int bucket_of(struct bot* bot, int a, int b)
+{
+        /* the light lit shooting at cell *a* with the target on *b* */
+        int dy = abs(a / bot->width - b / bot->width);
+        int dx = abs(a % bot->width - b % bot->width);
+
+        return bot->bucket_at[dy * bot->width + dx];
+}
+
+static void learn(struct bot* bot, point shot, int bucket)
+{
+        /* keep the candidates which would have lit *bucket* */
+        int cell = shot.y * bot->width + shot.x;
+        int i, n = 0;
+
+        bot->shot[cell] = 1;
+        bot->shots++;
+        for (i=0; i<bot->n_cand; i++) {
+                if (bucket_of(bot, cell, bot->cand[i]) == bucket)
+                        bot->cand[n++] = bot->cand[i];
+        }
+        bot->n_cand = n;
+}
+
+static point random_aim(struct bot* bot)
+{
+        int h = TARGET_MAX_Y(bot->height) - TARGET_MIN_Y + 1;
+        int w = TARGET_MAX_X(bot->width) - TARGET_MIN_X + 1;
+        point p;
+
+        do {
+                p.y = TARGET_MIN_Y + rng_below(&bot->rng, h);
+                p.x = TARGET_MIN_X + rng_below(&bot->rng, w);
+        } while (bot->shot[p.y * bot->width + p.x]);
+        return p;
+}
+
+static point consistent_aim(struct bot* bot)
+{
+        if (bot->n_cand == 0)           /* can not be, but who knows */
+                return random_aim(bot);
+        return cell_point(bot, bot->cand[rng_below(&bot->rng, bot->n_cand)]);
+}
+
+static long split_score(struct bot* bot, int shooter)
+{
+        /* how many candidates are left on average shooting at *shooter*,
+         * times the candidates now: a hit leaves none to look for */
+        long count[N_BUCKETS] = {0};
+        long score = 0;
+        int i;
+
+        for (i=0; i<bot->n_cand; i++)
+                count[bucket_of(bot, shooter, bot->cand[i])]++;
+        for (i=0; i<N_BUCKETS; i++) {
+                if (i != BUCKET_HIT)
+                        score += count[i] * count[i];
+        }
+        return score;
+}
+
+static point split_aim(struct bot* bot)
+{
+        long score, best = LONG_MAX;
+        int i, cell, choice = -1;
+
+        if (bot->shots == 0)
+                return bot->opening;
+        if (bot->n_cand == 0)
+                return random_aim(bot);
+
+        /* every candidate when they are few, a sample of them otherwise */
+        for (i=0; i<SPLIT_SHOOTERS && i<bot->n_cand; i++) {
+                if (bot->n_cand <= SPLIT_SHOOTERS)
+                        cell = bot->cand[i];
+                else
+                        cell = bot->cand[rng_below(&bot->rng, bot->n_cand)];
+                score = split_score(bot, cell);
+                if (score < best) {
+                        best = score;
+                        choice = cell;
+                }
+        }
+        return cell_point(bot, choice);
+}
@@ -0,0 +1,66 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Bots: players which see what a player sees, i.e. where they shot and
+ * which light of the lamp it lit (the distance bucket), and nothing of the
+ * target. They play through the engine, moving the gunsight and shooting
+ * with game_step() like the keys do.
+ *
+ * A strategy only chooses the next shot. The bot keeps, for any strategy
+ * to use, the cells where the target can still be: those agreeing with
+ * every bucket seen so far.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef BOT_H
+#define BOT_H
+
+#include "engine.h"
+#include "rng.h"
+
+#define SPLIT_SHOOTERS 32       /* cells tried by the "split" strategy */
+
+/* ---------------------------------------------------------------------------
+ * data structures definition
+ */
+struct bot;
+
+struct strategy
+{
+        const char* name;
+        point (*aim)(struct bot* bot);  /* where to shoot next */
+};
+
+struct bot
+{
+        const struct strategy* strategy;
+        int height, width;      /* of the field, border included */
+        struct rng rng;         /* the bot's own, reseeded every game */
+
+        /* the bucket of a shot *dy*, *dx* cells away from the target, at
+         * [dy * width + dx] */
+        unsigned char* bucket_at;
+
+        /* the cells where the target can be, as field indexes */
+        int* cand;
+        int n_cand;
+        int n_start;            /* before the first shot */
+
+        unsigned char* shot;    /* the cells shot in this game */
+        int shots;
+
+        point opening;          /* the first shot of "split" */
+};
+
+extern const struct strategy* const strategies[];       /* NULL ended */
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+void bot_free(struct bot* bot);
+void bot_init(struct bot* bot, const struct strategy* strategy,
+              int height, int width);
+int bot_play(struct bot* bot, game_state* game, uint64_t seed);
+
+#endif /* BOT_H */
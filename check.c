@@ -0,0 +1,138 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Checks, run by `make check': distance() and distance_batch() of the
+ * engine against the formula of the first version of the game (floor of
+ * sqrt(pow() + pow()), then the cells beside the center of the target
+ * taken as hits), for every offset between two cells of the largest field
+ * (FIELD_MAX x FIELD_MAX) in every direction. The batch goes a row of
+ * offsets at a time, whose length is no multiple of the SIMD width: the
+ * scalar tail is checked too.
+ *
+ * `make check' runs it twice: on the engine as built (SSE2 on x86-64) and
+ * on one built with -mavx2, called with `avx2' so that a CPU without it
+ * skips that run rather than failing.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "engine.h"
+
+#define SPAN (2 * FIELD_MAX - 1)        /* offsets on an axis */
+#define MISMATCHES 10                   /* reported, at most */
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+static unsigned int formula(point shot, point target);
+static void mismatch(const char* what, int dy, int dx, unsigned int got,
+                     unsigned int want);
+/* -------------------------------------------------------------------------- */
+
+static unsigned long mismatches;
+
+int main(int argc, char* argv[])
+{
+        int* ay = malloc(SPAN * sizeof(int));
+        int* ax = malloc(SPAN * sizeof(int));
+        int* by = malloc(SPAN * sizeof(int));
+        int* bx = malloc(SPAN * sizeof(int));
+        unsigned int* dist = malloc(SPAN * sizeof(unsigned int));
+        unsigned int want;
+        point a, b;
+        int dy, dx, i;
+
+        if (!ay || !ax || !by || !bx || !dist) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+
+#if defined(__x86_64__) || defined(__i386__)
+        if (argc > 1 && strcmp(argv[1], "avx2") == 0 &&
+            !__builtin_cpu_supports("avx2")) {
+                printf("mtcheck: no AVX2 on this CPU, skipped\n");
+                return 0;
+        }
+#endif
+
+        /* *a* in the middle of the field, *b* anywhere on it */
+        a.y = a.x = FIELD_MAX - 1;
+        for (i=0; i<SPAN; i++) {
+                ay[i] = a.y;
+                ax[i] = a.x;
+                bx[i] = i;
+        }
+
+        for (dy=-(FIELD_MAX-1); dy<FIELD_MAX; dy++) {
+                b.y = a.y + dy;
+                for (i=0; i<SPAN; i++)
+                        by[i] = b.y;
+                distance_batch(ay, ax, by, bx, dist, SPAN);
+
+                for (i=0; i<SPAN; i++) {
+                        b.x = i;
+                        dx = b.x - a.x;
+                        want = formula(a, b);
+                        if (distance(a, b) != want)
+                                mismatch("distance()", dy, dx,
+                                         distance(a, b), want);
+                        if (dist[i] != want)
+                                mismatch("distance_batch()", dy, dx,
+                                         dist[i], want);
+                }
+        }
+
+        printf("mtcheck: %lu offsets%s, %lu mismatches\n",
+               (unsigned long)SPAN * SPAN, argc > 1 ? " (avx2)" : "",
+               mismatches);
+
+        free(ay);
+        free(ax);
+        free(by);
+        free(bx);
+        free(dist);
+        return mismatches != 0;
+}
+
+static void mismatch(const char* what, int dy, int dx, unsigned int got,
+                     unsigned int want)
+{
+        if (mismatches++ < MISMATCHES)
+                fprintf(stderr, "mtcheck: %s is %u at dy %d dx %d, "
+                        "the formula gives %u\n", what, got, dy, dx, want);
+}
+
+static unsigned int formula(point shot, point target)
+{
+        /* distance() as the game first had it */
+        int true_dist, adjusted_dist, x_dist, y_dist;
+
+        x_dist = abs(target.x - shot.x);
+        y_dist = abs(target.y - shot.y);
+        true_dist = floor(sqrt(pow(x_dist, 2) + pow(y_dist, 2)));
+
+        if (true_dist < 4) {
+                switch (y_dist) {
+                case 0:
+                        if (x_dist == 3 || x_dist == 2) adjusted_dist = 1;
+                        else adjusted_dist = true_dist;
+                        break;
+                case 1:
+                        if (x_dist == 2) adjusted_dist = 1;
+                        else adjusted_dist = true_dist;
+                        break;
+                default:
+                        adjusted_dist = true_dist;
+                        break;
+                }
+                return adjusted_dist;
+        }
+        else {
+                return true_dist;
+        }
+}
@@ -0,0 +1,615 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Magic Target game rules. Nothing in here knows about ncurses: see
+ * engine.h for the interface.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "engine.h"
+
+static void* game_alloc(game_state* game, size_t size)
+{
+        void* p = arena_alloc(&game->mem, size);
+
+        if (!p) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        return p;
+}
+
+static size_t shot_bytes(int cap)
+{
+        /* the block shot_room() takes for *cap* shots */
+        return 3 * ARENA_SIZEOF(cap * sizeof(int)) +
+                ARENA_SIZEOF(cap * sizeof(unsigned short)) +
+                ARENA_SIZEOF(cap);
+}
+
+static void shot_room(struct shot_buf* shots, int cap)
+{
+        /* room for *cap* shots, those fired so far moved over. With none
+         * fired, the block of the last game is kept if large enough */
+        struct arena grown = {0};
+        struct arena* a = shots->len ? &grown : &shots->mem;
+        int *x, *y, *next;
+        unsigned short* distance;
+        unsigned char* bucket;
+
+        if (!arena_reserve(a, shot_bytes(cap))) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        x = arena_alloc(a, cap * sizeof(int));
+        y = arena_alloc(a, cap * sizeof(int));
+        next = arena_alloc(a, cap * sizeof(int));
+        distance = arena_alloc(a, cap * sizeof(unsigned short));
+        bucket = arena_alloc(a, cap);
+
+        if (shots->len) {
+                memcpy(x, shots->x, shots->len * sizeof(int));
+                memcpy(y, shots->y, shots->len * sizeof(int));
+                memcpy(next, shots->tile_next, shots->len * sizeof(int));
+                memcpy(distance, shots->distance,
+                       shots->len * sizeof(unsigned short));
+                memcpy(bucket, shots->bucket, shots->len);
+                arena_release(&shots->mem);
+                shots->mem = grown;
+        }
+        shots->x = x;
+        shots->y = y;
+        shots->tile_next = next;
+        shots->distance = distance;
+        shots->bucket = bucket;
+        shots->cap = cap;
+}
+
+void game_init(game_state* game, game_conf* conf, int height, int width)
+{
+        /* set up a new game on a *height* x *width* field, following the
+         * player choices in *conf*. *game* must be zeroed the first time,
+         * later calls reuse the memory of the previous game.
+         */
+        size_t cells = (size_t)height * width;
+        int ammo = AMMO_AVAILABLE(conf->level);
+        int cap = ammo ? ammo : PRACTICE_SHOTS;
+        int tiles_x = (width + SHOT_TILE_W-1) / SHOT_TILE_W;
+        int tiles = (height + SHOT_TILE_H-1) / SHOT_TILE_H * tiles_x;
+        size_t mapped = cells <= MAP_CELLS ? cells : 0;
+
+        if (!arena_reserve(&game->mem,
+                           ARENA_SIZEOF(mapped * sizeof(unsigned short)) +
+                           ARENA_SIZEOF(mapped) +
+                           ARENA_SIZEOF(5 * width * sizeof(int)) +
+                           ARENA_SIZEOF(tiles * sizeof(int)) +
+                           ARENA_SIZEOF((cells + 7) / 8))) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+
+        game->height = height;
+        game->width = width;
+        game->timer = conf->timer;
+        game->status = GAME_RUNNING;
+        game->ammo_tot = ammo;
+        game->ammo_left = ammo;
+        game->game_time = TIME_VALUE;
+        game->dist = 100;
+        rng_seed(&game->rng, conf->seed);
+
+        game->dist_map = NULL;
+        game->bucket_map = NULL;
+        if (mapped) {
+                game->dist_map = game_alloc(game,
+                                            mapped * sizeof(unsigned short));
+                game->bucket_map = game_alloc(game, mapped);
+        }
+        game->map_rows = game_alloc(game, 5 * width * sizeof(int));
+
+        /* get a random target */
+        game->target = get_new_target(game);
+        map_target(game);
+
+        /* the gunsight starts in the middle of the field */
+        game->gunsight.y = height / 2;
+        game->gunsight.x = width / 2;
+
+        /* room for every shot the player can fire. In practice for as many
+         * as the block of the last game holds, PRACTICE_SHOTS at least:
+         * a long game grows it once, not every game */
+        if (!ammo)
+                while (cap <= INT_MAX / 4 &&
+                       shot_bytes(2 * cap) <= game->shots.mem.size)
+                        cap *= 2;
+        game->shots.len = 0;
+        shot_room(&game->shots, cap);
+        game->target_shots = 0;
+
+        /* no shot on any tile yet */
+        game->shots.tile_first = game_alloc(game, tiles * sizeof(int));
+        game->shots.fell = game_alloc(game, (cells + 7) / 8);
+        game->shots.tiles_x = tiles_x;
+        memset(game->shots.tile_first, -1, tiles * sizeof(int));
+        memset(game->shots.fell, 0, (cells + 7) / 8);
+}
+
+void game_free(game_state* game)
+{
+        /* give back the memory of the last game */
+        arena_release(&game->mem);
+        arena_release(&game->shots.mem);
+        game->dist_map = NULL;
+        game->bucket_map = NULL;
+        game->map_rows = NULL;
+        game->shots.len = game->shots.cap = 0;
+}
+
+static void move_target(game_state* game)
+{
+        /* a new target, the shots so far being for the old one */
+        game->target = get_new_target(game);
+        map_target(game);
+        game->target_shots = game->shots.len;
+}
+
+int game_step(game_state* game, int input)
+{
+        /* apply *input* to the game and return the EV_* mask of what
+         * changed. Once the game is over every input is ignored.
+         */
+        point* gs = &game->gunsight;
+        int events = 0;
+
+        if (game->status != GAME_RUNNING)
+                return 0;
+
+        switch (input) {
+        case IN_UP:
+                if (gs->y > 1) gs->y--;       /* consider field border */
+                events |= EV_GUNSIGHT;
+                break;
+        case IN_RIGHT:
+                if (gs->x < game->width-2) gs->x++;
+                events |= EV_GUNSIGHT;
+                break;
+        case IN_DOWN:
+                if (gs->y < game->height-2) gs->y++;
+                events |= EV_GUNSIGHT;
+                break;
+        case IN_LEFT:
+                if (gs->x > 1) gs->x--;
+                events |= EV_GUNSIGHT;
+                break;
+        case IN_SHOOT:
+                if (game->ammo_tot)
+                        game->ammo_left--;
+                game->dist = target_distance(game, *gs);
+                push_shot(game, *gs, game->dist, target_bucket(game, *gs));
+                events |= EV_SHOT;
+                break;
+        case IN_TICK:
+                if (!game->timer)
+                        break;
+                game->game_time--;
+                events |= EV_TIME;
+                if (game->game_time == 0) {
+                        move_target(game);
+                        game->game_time = TIME_VALUE;
+                        events |= EV_NEW_TARGET;
+                }
+                break;
+        default:
+                break;
+        }
+
+        /* check if win or lose: in practice never, a hit only moves the
+         * target */
+        if (game->ammo_tot == 0) {
+                if ((events & EV_SHOT) && game->dist < 2) {
+                        move_target(game);
+                        events |= EV_NEW_TARGET;
+                        if (game->timer) {
+                                game->game_time = TIME_VALUE;
+                                events |= EV_TIME;
+                        }
+                }
+        }
+        else if (game->dist < 2)
+                game->status = GAME_WIN;
+        else if (game->ammo_left == 0)
+                game->status = GAME_LOSE;
+
+        if (game->status != GAME_RUNNING)
+                events |= EV_OVER;
+
+        return events;
+}
+
+point get_random_point(struct rng* rng, int max_y, int max_x)
+{
+        point p;
+
+        p.y = rng_below(rng, max_y);
+        p.x = rng_below(rng, max_x);
+        return p;
+}
+
+point get_new_target(game_state* game)
+{
+        return clamp_target(get_random_point(&game->rng, game->height-2,
+                                             game->width-4));
+}
+
+point clamp_target(point p)
+{
+        /* where get_new_target() moves a random point *p* */
+        if (p.y < 4) p.y = 3;    /* avoiding to cover the border */
+        if (p.x < 4) p.x = 4;
+
+        return p;
+}
+
+int distance_bucket(unsigned int dist)
+{
+        if (dist < 2)
+                return BUCKET_HIT;
+        else if (dist < 10)
+                return BUCKET_NEAR;
+        else if (dist < 20)
+                return BUCKET_MID;
+        else if (dist < 30)
+                return BUCKET_FAR;
+        else
+                return BUCKET_MISS;
+}
+
+static inline unsigned int isqrt(unsigned int n)
+{
+        /* floor(sqrt(n)), exact: the float square root is only an estimate
+         * (off by at most one), fixed up with integer arithmetic */
+        unsigned int r = (unsigned int)sqrtf((float)n);
+
+        if (r*r > n)
+                r--;
+        else if ((r+1)*(r+1) <= n)
+                r++;
+        return r;
+}
+
+unsigned int distance(point shot, point target)
+{
+        unsigned int x_dist, y_dist;
+
+        /* Siamo figli di Pitagora e di Caaaasaadeeeei ... */
+        x_dist = abs(target.x - shot.x);
+        y_dist = abs(target.y - shot.y);
+
+        /* adjust the distance considering that the target is wider than
+         * higher: the cells beside the center are hits as well */
+        if ((y_dist == 0 && (x_dist == 2 || x_dist == 3)) ||
+            (y_dist == 1 && x_dist == 2))
+                return 1;
+
+        return isqrt(x_dist*x_dist + y_dist*y_dist);
+}
+
+#if defined(__AVX2__)
+static int distance_batch_simd(const int* ay, const int* ax,
+                               const int* by, const int* bx,
+                               unsigned int* dist, int n)
+{
+        /* 8 pairs at a time, same steps as distance() */
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i two = _mm256_set1_epi32(2);
+        const __m256i three = _mm256_set1_epi32(3);
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i dx, dy, d2, r, r1, wide;
+        int i;
+
+        for (i=0; i+8<=n; i+=8) {
+                dy = _mm256_sub_epi32(
+                        _mm256_loadu_si256((const __m256i*)(by+i)),
+                        _mm256_loadu_si256((const __m256i*)(ay+i)));
+                dx = _mm256_sub_epi32(
+                        _mm256_loadu_si256((const __m256i*)(bx+i)),
+                        _mm256_loadu_si256((const __m256i*)(ax+i)));
+                dy = _mm256_abs_epi32(dy);
+                dx = _mm256_abs_epi32(dx);
+                d2 = _mm256_add_epi32(_mm256_mullo_epi32(dx, dx),
+                                      _mm256_mullo_epi32(dy, dy));
+
+                /* estimate, then fix up as isqrt() does */
+                r = _mm256_cvttps_epi32(_mm256_sqrt_ps(
+                                        _mm256_cvtepi32_ps(d2)));
+                r = _mm256_add_epi32(r, _mm256_cmpgt_epi32(
+                                     _mm256_mullo_epi32(r, r), d2));
+                r1 = _mm256_add_epi32(r, one);
+                r = _mm256_sub_epi32(r, _mm256_andnot_si256(
+                                     _mm256_cmpgt_epi32(
+                                     _mm256_mullo_epi32(r1, r1), d2),
+                                     _mm256_set1_epi32(-1)));
+
+                /* the target is wider than higher */
+                wide = _mm256_or_si256(
+                        _mm256_and_si256(
+                                _mm256_cmpeq_epi32(dy, zero),
+                                _mm256_or_si256(
+                                        _mm256_cmpeq_epi32(dx, two),
+                                        _mm256_cmpeq_epi32(dx, three))),
+                        _mm256_and_si256(
+                                _mm256_cmpeq_epi32(dy, one),
+                                _mm256_cmpeq_epi32(dx, two)));
+                r = _mm256_blendv_epi8(r, one, wide);
+
+                _mm256_storeu_si256((__m256i*)(dist+i), r);
+        }
+        return i;
+}
+#elif defined(__SSE2__)
+static inline __m128i mullo_epi32(__m128i a, __m128i b)
+{
+        /* SSE2 has no 32 bit low multiply: do even and odd lanes apart */
+        __m128i even = _mm_mul_epu32(a, b);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32),
+                                    _mm_srli_epi64(b, 32));
+
+        return _mm_unpacklo_epi32(
+                _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128i abs_epi32(__m128i a)
+{
+        __m128i sign = _mm_srai_epi32(a, 31);
+
+        return _mm_sub_epi32(_mm_xor_si128(a, sign), sign);
+}
+
+static int distance_batch_simd(const int* ay, const int* ax,
+                               const int* by, const int* bx,
+                               unsigned int* dist, int n)
+{
+        /* 4 pairs at a time, same steps as distance() */
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i two = _mm_set1_epi32(2);
+        const __m128i three = _mm_set1_epi32(3);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i dx, dy, d2, r, r1, wide;
+        int i;
+
+        for (i=0; i+4<=n; i+=4) {
+                dy = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(by+i)),
+                                   _mm_loadu_si128((const __m128i*)(ay+i)));
+                dx = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(bx+i)),
+                                   _mm_loadu_si128((const __m128i*)(ax+i)));
+                dy = abs_epi32(dy);
+                dx = abs_epi32(dx);
+                d2 = _mm_add_epi32(mullo_epi32(dx, dx), mullo_epi32(dy, dy));
+
+                /* estimate, then fix up as isqrt() does */
+                r = _mm_cvttps_epi32(_mm_sqrt_ps(_mm_cvtepi32_ps(d2)));
+                r = _mm_add_epi32(r, _mm_cmpgt_epi32(mullo_epi32(r, r), d2));
+                r1 = _mm_add_epi32(r, one);
+                r = _mm_sub_epi32(r, _mm_andnot_si128(
+                                  _mm_cmpgt_epi32(mullo_epi32(r1, r1), d2),
+                                  _mm_set1_epi32(-1)));
+
+                /* the target is wider than higher */
+                wide = _mm_or_si128(
+                        _mm_and_si128(_mm_cmpeq_epi32(dy, zero),
+                                      _mm_or_si128(_mm_cmpeq_epi32(dx, two),
+                                                   _mm_cmpeq_epi32(dx, three))),
+                        _mm_and_si128(_mm_cmpeq_epi32(dy, one),
+                                      _mm_cmpeq_epi32(dx, two)));
+                r = _mm_or_si128(_mm_and_si128(wide, one),
+                                 _mm_andnot_si128(wide, r));
+
+                _mm_storeu_si128((__m128i*)(dist+i), r);
+        }
+        return i;
+}
+#else
+static int distance_batch_simd(const int* ay, const int* ax,
+                               const int* by, const int* bx,
+                               unsigned int* dist, int n)
+{
+        return 0;
+}
+#endif
+
+void distance_batch(const int* ay, const int* ax, const int* by,
+                    const int* bx, unsigned int* dist, int n)
+{
+        /* dist[i] = distance((ax[i], ay[i]), (bx[i], by[i])) for the *n*
+         * pairs, using SSE2/AVX2 when the compiler targets them. The
+         * coordinates of a pair must differ by less than 32768.
+         */
+        point a, b;
+        int i = distance_batch_simd(ay, ax, by, bx, dist, n);
+
+        for (; i<n; i++) {
+                a.y = ay[i];
+                a.x = ax[i];
+                b.y = by[i];
+                b.x = bx[i];
+                dist[i] = distance(a, b);
+        }
+}
+
+void push_shot(game_state* game, point coords, unsigned int distance,
+               int bucket)
+{
+        /* record a shot; the buffer was sized for all the ammo at
+         * game_init(), so extra shots are simply not recorded. In practice
+         * it grows instead */
+        struct shot_buf* shots = &game->shots;
+        int i = shots->len;
+        int cell = coords.y * game->width + coords.x;
+        int tile;
+
+        if (i == shots->cap) {
+                if (game->ammo_tot || i > INT_MAX / 2)
+                        return;
+                shot_room(shots, 2 * i);
+        }
+
+        shots->x[i] = coords.x;
+        shots->y[i] = coords.y;
+        shots->distance[i] = distance < USHRT_MAX ? distance : USHRT_MAX;
+        shots->bucket[i] = bucket;
+        shots->len++;
+
+        /* the first at its cell goes on top of its tile's list */
+        if (shots->fell[cell / 8] & 1 << cell % 8)
+                return;
+        shots->fell[cell / 8] |= 1 << cell % 8;
+        tile = coords.y / SHOT_TILE_H * shots->tiles_x +
+                coords.x / SHOT_TILE_W;
+        shots->tile_next[i] = shots->tile_first[tile];
+        shots->tile_first[tile] = i;
+}
+
+int shot_at(game_state* game, point p)
+{
+        /* the first shot fired at the cell *p*, -1 if none was */
+        struct shot_buf* shots = &game->shots;
+        int cell = p.y * game->width + p.x;
+        int i;
+
+        if (p.y < 0 || p.x < 0 || p.y >= game->height || p.x >= game->width ||
+            !(shots->fell[cell / 8] & 1 << cell % 8))
+                return -1;
+
+        i = shots->tile_first[p.y / SHOT_TILE_H * shots->tiles_x +
+                              p.x / SHOT_TILE_W];
+        while (i >= 0 && (shots->y[i] != p.y || shots->x[i] != p.x))
+                i = shots->tile_next[i];
+        return i;
+}
+
+void shot_iter_start(struct shot_iter* it, game_state* game, int top,
+                     int left, int bottom, int right)
+{
+        /* walk with shot_iter_next() the cells shot at from *top*, *left*
+         * to *bottom*, *right* included, clipped to the field */
+        it->shots = &game->shots;
+        it->top = top > 0 ? top : 0;
+        it->left = left > 0 ? left : 0;
+        it->bottom = bottom < game->height ? bottom : game->height-1;
+        it->right = right < game->width ? right : game->width-1;
+        it->ty = it->top / SHOT_TILE_H;
+        it->tx = it->left / SHOT_TILE_W;
+        it->next = -1;
+        if (it->top <= it->bottom && it->left <= it->right)
+                it->next = it->shots->tile_first[it->ty * it->shots->tiles_x +
+                                                 it->tx];
+        else
+                it->ty = it->bottom / SHOT_TILE_H + 1;  /* nothing to walk */
+}
+
+int shot_iter_next(struct shot_iter* it)
+{
+        /* the first shot at the next cell shot at, -1 when there are no
+         * more. Tile by tile, newest first */
+        struct shot_buf* shots = it->shots;
+        int i;
+
+        while (it->ty <= it->bottom / SHOT_TILE_H) {
+                while ((i = it->next) >= 0) {
+                        it->next = shots->tile_next[i];
+                        if (shots->y[i] >= it->top &&
+                            shots->y[i] <= it->bottom &&
+                            shots->x[i] >= it->left &&
+                            shots->x[i] <= it->right)
+                                return i;
+                }
+
+                /* on to the next tile of the rectangle */
+                if (++it->tx > it->right / SHOT_TILE_W) {
+                        it->tx = it->left / SHOT_TILE_W;
+                        it->ty++;
+                }
+                if (it->ty <= it->bottom / SHOT_TILE_H)
+                        it->next = shots->tile_first[it->ty * shots->tiles_x +
+                                                     it->tx];
+        }
+        return -1;
+}
+
+void map_target(game_state* game)
+{
+        /* fill the distance and bucket maps for the current target, a row
+         * at a time through distance_batch(); nothing without maps. The
+         * bucket is counted rather than branched on, as distance_bucket()
+         * does, so that the loop vectorizes
+         */
+        int* xs = game->map_rows;
+        int* ys = xs + game->width;
+        int* tys = ys + game->width;
+        int* txs = tys + game->width;
+        unsigned int* row = (unsigned int*)(txs + game->width);
+        unsigned short* dist = game->dist_map;
+        unsigned char* bucket = game->bucket_map;
+        unsigned int d;
+        int x, y;
+
+        if (!dist)
+                return;
+
+        for (x=0; x<game->width; x++) {
+                xs[x] = x;
+                tys[x] = game->target.y;
+                txs[x] = game->target.x;
+        }
+        for (y=0; y<game->height; y++) {
+                for (x=0; x<game->width; x++)
+                        ys[x] = y;
+                distance_batch(ys, xs, tys, txs, row, game->width);
+
+                for (x=0; x<game->width; x++) {
+                        d = row[x];
+                        dist[x] = d;
+                        bucket[x] = BUCKET_HIT + (d >= 2) + (d >= 10) +
+                                (d >= 20) + (d >= 30);
+                }
+                dist += game->width;
+                bucket += game->width;
+        }
+}
+
+const unsigned int* target_row(game_state* game, int y, int x, int n)
+{
+        /* the distances from the target of the *n* cells of row *y* from
+         * column *x* on, through distance_batch(): good until the next
+         * call, *n* being the width of the field at most
+         */
+        int* xs = game->map_rows;
+        int* ys = xs + game->width;
+        int* tys = ys + game->width;
+        int* txs = tys + game->width;
+        unsigned int* row = (unsigned int*)(txs + game->width);
+        int i;
+
+        for (i=0; i<n; i++) {
+                xs[i] = x + i;
+                ys[i] = y;
+                tys[i] = game->target.y;
+                txs[i] = game->target.x;
+        }
+        distance_batch(ys, xs, tys, txs, row, n);
+        return row;
+}
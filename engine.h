@@ -0,0 +1,190 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Magic Target game rules, with no terminal attached: the target placement,
+ * the shot scoring, the ammo accounting and the win/lose checks live here.
+ * The ncurses front-end (and anything else that wants to play, e.g. bots)
+ * drives a game feeding inputs to game_step() and looking at the returned
+ * events to know what changed.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdbool.h>
+
+#include "arena.h"
+#include "rng.h"
+
+#define MAX_PN_LEN 13 /* max name length for player */
+
+#define FIELD_HEIGHT 15 /* the playing field, border included */
+#define FIELD_WIDTH 65
+#define FIELD_MAX 4096  /* a side of the field at most */
+
+/* fields of up to so many cells keep the distance and bucket of every cell
+ * from the target, see game_state: 3 bytes a cell, filled in 20 us or so
+ * at most whenever the target moves. Larger ones work a cell out when
+ * asked */
+#define MAP_CELLS (64 * 64)
+
+#define TIME_VALUE 30
+
+#define GAME_RUNNING 0
+#define GAME_WIN 1
+#define GAME_LOSE 2
+
+#define AMMO_AVAILABLE(level) (30 - ((level)-1)*10)
+
+/* practice: no ammo count (AMMO_AVAILABLE() is 0), the game never ends and
+ * a hit just moves the target; the room for shots starts at PRACTICE_SHOTS
+ * and doubles whenever it is full. The next game starts with what the last
+ * one grew to */
+#define LEVEL_PRACTICE 4
+#define PRACTICE_SHOTS 1024
+
+/* the tiles of the shot index, see shot_buf */
+#define SHOT_TILE_H 8
+#define SHOT_TILE_W 16
+
+/* lamp buckets of a shot, from the nearest to the farthest */
+#define BUCKET_HIT 0    /* distance < 2 */
+#define BUCKET_NEAR 1   /* distance < 10 */
+#define BUCKET_MID 2    /* distance < 20 */
+#define BUCKET_FAR 3    /* distance < 30 */
+#define BUCKET_MISS 4
+#define N_BUCKETS 5
+
+/* inputs accepted by game_step() */
+#define IN_NONE 0
+#define IN_UP 1
+#define IN_RIGHT 2
+#define IN_DOWN 3
+#define IN_LEFT 4
+#define IN_SHOOT 5
+#define IN_TICK 6       /* a second of countdown elapsed */
+
+/* events returned by game_step(), as a bit mask */
+#define EV_GUNSIGHT 0x01
+#define EV_SHOT 0x02
+#define EV_TIME 0x04
+#define EV_NEW_TARGET 0x08
+#define EV_OVER 0x10
+
+/* ---------------------------------------------------------------------------
+ * data structures definition
+ */
+typedef struct
+{
+        int x;
+        int y;
+} point;
+
+/* the shots fired in a game, in firing order: one array per field so that
+ * walking the coords or the buckets stays in cache. The first shot to
+ * fall on a cell, the one shown there, is also listed in the tile of
+ * SHOT_TILE_H x SHOT_TILE_W cells around it: the shots in a part of the
+ * field are found walking a few short lists, however many were fired */
+struct shot_buf
+{
+        int* x;
+        int* y;
+        unsigned short* distance;
+        unsigned char* bucket;
+        int len;
+        int cap;
+        struct arena mem;       /* of the arrays above and tile_next */
+
+        int* tile_first;        /* per tile, its newest shot, -1 for none */
+        int* tile_next;         /* per shot listed, the previous in its tile */
+        unsigned char* fell;    /* a bit per cell, set once shot at */
+        int tiles_x;            /* tiles in a row */
+};
+
+/* the cells of a rectangle with a shot, see shot_iter_start() */
+struct shot_iter
+{
+        struct shot_buf* shots;
+        int top, left, bottom, right;   /* the rectangle, inclusive */
+        int ty, tx;                     /* the tile being walked */
+        int next;                       /* shot in it, -1 at its end */
+};
+
+typedef struct
+{
+        char player_name[MAX_PN_LEN];
+        int level;
+        bool timer;
+        uint64_t seed;          /* the same seed, the same targets */
+} game_conf;
+
+typedef struct
+{
+        int height, width;      /* playing field, border included */
+        bool timer;
+        int status;
+        point target;
+        point gunsight;
+        int ammo_tot;           /* 0 in practice */
+        int ammo_left;
+        int game_time;
+        unsigned int dist;      /* distance of the last shot */
+        struct shot_buf shots;
+        int target_shots;       /* shots fired before the current target */
+        struct rng rng;         /* where the targets come from */
+
+        /* distance and bucket of every cell of the field from the current
+         * target, row by row: rebuilt only when the target changes. NULL
+         * on a field of more than MAP_CELLS cells */
+        unsigned short* dist_map;
+        unsigned char* bucket_map;
+        int* map_rows;          /* scratch rows of map_target(), target_row() */
+
+        /* backing store of the maps and scratch rows, reset by
+         * game_init() */
+        struct arena mem;
+} game_state;
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+point clamp_target(point p);
+unsigned int distance(point a, point b);
+int distance_bucket(unsigned int dist);
+void distance_batch(const int* ay, const int* ax, const int* by,
+                    const int* bx, unsigned int* dist, int n);
+void game_free(game_state* game);
+void game_init(game_state* game, game_conf* configuration,
+               int height, int width);
+int game_step(game_state* game, int input);
+point get_new_target(game_state* game);
+point get_random_point(struct rng* rng, int max_y, int max_x);
+void map_target(game_state* game);
+void push_shot(game_state* game, point new_shot, unsigned int new_distance,
+               int new_bucket);
+int shot_at(game_state* game, point p);
+int shot_iter_next(struct shot_iter* it);
+void shot_iter_start(struct shot_iter* it, game_state* game, int top,
+                     int left, int bottom, int right);
+const unsigned int* target_row(game_state* game, int y, int x, int n);
+
+/* what a cell scores off the current target: looked up in the maps, or
+ * worked out when asked (a few ns) on a field too large for them. See
+ * target_row() for a row of cells at once */
+static inline unsigned int target_distance(game_state* game, point p)
+{
+        if (game->dist_map)
+                return game->dist_map[p.y * game->width + p.x];
+        return distance(p, game->target);
+}
+
+static inline int target_bucket(game_state* game, point p)
+{
+        if (game->bucket_map)
+                return game->bucket_map[p.y * game->width + p.x];
+        return distance_bucket(distance(p, game->target));
+}
+
+#endif /* ENGINE_H */
@@ -0,0 +1,357 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * The bot evaluator, see eval.h.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "eval.h"
+#include "bot.h"
+
+#define MAX_AMMO AMMO_AVAILABLE(1)
+
+/* ---------------------------------------------------------------------------
+ * data structures definition
+ */
+
+/* games *first* to *first* + *count* - 1 of a strategy at a level */
+struct task
+{
+        int job;                /* strategy * EVAL_LEVELS + level - 1 */
+        unsigned long first;
+        unsigned long count;
+};
+
+/* the owner pushes and pops at the bottom, thieves take from the top */
+struct deque
+{
+        pthread_mutex_t lock;
+        struct task* tasks;
+        int top, bottom, cap;
+};
+
+/* how the games of a job went */
+struct tally
+{
+        unsigned long won[MAX_AMMO+1];  /* by shots fired */
+        unsigned long lost;
+};
+
+struct worker
+{
+        pthread_t thread;
+        int id;
+        struct deque deque;
+        struct rng rng;                 /* picks the victims */
+        struct tally* tally;            /* by job */
+        unsigned long steals;
+};
+
+/* ---------------------------------------------------------------------------
+ * global vars
+ */
+static struct worker* pool;
+static int n_workers;
+static int n_strategies;
+static uint64_t base_seed;
+static unsigned long pending;   /* games not played yet, atomic */
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+static bool deque_pop(struct deque* d, struct task* t);
+static void deque_push(struct deque* d, struct task t);
+static bool deque_steal(struct deque* d, struct task* t);
+static double now(void);
+static void play(struct worker* w, struct bot* bots, game_state* game,
+                 struct task t);
+static void report(FILE* out, struct tally* tally, unsigned long games);
+static bool steal(struct worker* w, struct task* t);
+static void* work(void* arg);
+/* -------------------------------------------------------------------------- */
+
+int eval_run(unsigned long games, int threads, uint64_t seed, FILE* out)
+{
+        /* play *games* games for every strategy and level on *threads*
+         * threads, then report on *out* */
+        struct tally* total;
+        unsigned long steals = 0;
+        struct task t;
+        double start, elapsed;
+        int jobs, i, j, k;
+
+        for (n_strategies=0; strategies[n_strategies]; n_strategies++);
+        jobs = n_strategies * EVAL_LEVELS;
+        n_workers = threads;
+        base_seed = seed;
+        pending = games * jobs;
+
+        pool = calloc(n_workers, sizeof(struct worker));
+        total = calloc(jobs, sizeof(struct tally));
+        if (pool == NULL || total == NULL) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+
+        /* the whole jobs, dealt round the workers */
+        for (i=0; i<n_workers; i++) {
+                pool[i].id = i;
+                pthread_mutex_init(&pool[i].deque.lock, NULL);
+                rng_seed(&pool[i].rng, seed + i);
+                pool[i].tally = calloc(jobs, sizeof(struct tally));
+                if (pool[i].tally == NULL) {
+                        fputs("Memory error.", stderr);
+                        exit(1);
+                }
+        }
+        for (i=0; i<jobs; i++) {
+                t.job = i;
+                t.first = 0;
+                t.count = games;
+                if (games)
+                        deque_push(&pool[i % n_workers].deque, t);
+        }
+
+        start = now();
+        for (i=1; i<n_workers; i++) {
+                if (pthread_create(&pool[i].thread, NULL, work, &pool[i])) {
+                        perror("pthread_create");
+                        exit(1);
+                }
+        }
+        work(&pool[0]);
+        for (i=1; i<n_workers; i++)
+                pthread_join(pool[i].thread, NULL);
+        elapsed = now() - start;
+
+        for (i=0; i<n_workers; i++) {
+                for (j=0; j<jobs; j++) {
+                        for (k=0; k<=MAX_AMMO; k++)
+                                total[j].won[k] += pool[i].tally[j].won[k];
+                        total[j].lost += pool[i].tally[j].lost;
+                }
+                steals += pool[i].steals;
+                free(pool[i].tally);
+                free(pool[i].deque.tasks);
+                pthread_mutex_destroy(&pool[i].deque.lock);
+        }
+
+        fprintf(out, "%lu games per strategy and level, seed %llu\n\n",
+                games, (unsigned long long)seed);
+        fprintf(out, "%-11s %5s %5s %7s %6s %4s %4s %4s  %s\n",
+                "strategy", "level", "ammo", "won%", "mean", "p50", "p90",
+                "max", "shots to win, 1 to ammo");
+        for (i=0; i<n_strategies; i++) {
+                for (j=0; j<EVAL_LEVELS; j++) {
+                        fprintf(out, "%-11s %5d %5d ", strategies[i]->name,
+                                j+1, AMMO_AVAILABLE(j+1));
+                        report(out, &total[i * EVAL_LEVELS + j], games);
+                }
+        }
+        fprintf(out, "\n%d threads, %lu steals, %.2f s, %.0f games/s\n",
+                n_workers, steals, elapsed,
+                elapsed > 0 ? games * jobs / elapsed : 0);
+
+        free(total);
+        free(pool);
+        return 0;
+}
+
+static void* work(void* arg)
+{
+        /* run tasks off our deque, or off somebody else's, until every
+         * game has been played */
+        struct worker* w = arg;
+        struct bot* bots = malloc(n_strategies * sizeof(struct bot));
+        game_state game;
+        struct task t, half;
+        int i;
+
+        if (bots == NULL) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        for (i=0; i<n_strategies; i++)
+                bot_init(&bots[i], strategies[i], FIELD_HEIGHT, FIELD_WIDTH);
+        memset(&game, 0, sizeof(game));
+
+        for (;;) {
+                if (!deque_pop(&w->deque, &t) && !steal(w, &t)) {
+                        if (__atomic_load_n(&pending, __ATOMIC_ACQUIRE) == 0)
+                                break;
+                        sched_yield();
+                        continue;
+                }
+
+                /* leave the second half to whoever is idle */
+                while (t.count > EVAL_GRAIN) {
+                        half = t;
+                        half.first += t.count / 2;
+                        half.count -= t.count / 2;
+                        t.count /= 2;
+                        deque_push(&w->deque, half);
+                }
+                play(w, bots, &game, t);
+                __atomic_sub_fetch(&pending, t.count, __ATOMIC_RELEASE);
+        }
+
+        game_free(&game);
+        for (i=0; i<n_strategies; i++)
+                bot_free(&bots[i]);
+        free(bots);
+        return NULL;
+}
+
+static void play(struct worker* w, struct bot* bots, game_state* game,
+                 struct task t)
+{
+        struct bot* bot = &bots[t.job / EVAL_LEVELS];
+        struct tally* tally = &w->tally[t.job];
+        game_conf conf;
+        struct rng r;
+        unsigned long i;
+        int shots;
+
+        memset(&conf, 0, sizeof(conf));
+        conf.level = t.job % EVAL_LEVELS + 1;
+        conf.timer = false;
+        for (i=t.first; i<t.first + t.count; i++) {
+                rng_seed(&r, base_seed + i);
+                conf.seed = rng_next64(&r);
+                game_init(game, &conf, FIELD_HEIGHT, FIELD_WIDTH);
+                shots = bot_play(bot, game, rng_next64(&r));
+                if (game->status == GAME_WIN)
+                        tally->won[shots]++;
+                else
+                        tally->lost++;
+        }
+}
+
+static bool steal(struct worker* w, struct task* t)
+{
+        /* try the others once each, from a random one */
+        int start = rng_below(&w->rng, n_workers);
+        int i, victim;
+
+        for (i=0; i<n_workers; i++) {
+                victim = (start + i) % n_workers;
+                if (victim == w->id)
+                        continue;
+                if (deque_steal(&pool[victim].deque, t)) {
+                        w->steals++;
+                        return true;
+                }
+        }
+        return false;
+}
+
+static void deque_push(struct deque* d, struct task t)
+{
+        struct task* tasks;
+
+        pthread_mutex_lock(&d->lock);
+        if (d->bottom == d->cap) {
+                if (d->top > 0) {       /* room left by the thieves */
+                        memmove(d->tasks, d->tasks + d->top,
+                                (d->bottom - d->top) * sizeof(struct task));
+                        d->bottom -= d->top;
+                        d->top = 0;
+                }
+                else {
+                        d->cap = d->cap ? 2 * d->cap : 16;
+                        tasks = realloc(d->tasks,
+                                        d->cap * sizeof(struct task));
+                        if (tasks == NULL) {
+                                fputs("Memory error.", stderr);
+                                exit(1);
+                        }
+                        d->tasks = tasks;
+                }
+        }
+        d->tasks[d->bottom++] = t;
+        pthread_mutex_unlock(&d->lock);
+}
+
+static bool deque_pop(struct deque* d, struct task* t)
+{
+        bool found = false;
+
+        pthread_mutex_lock(&d->lock);
+        if (d->bottom > d->top) {
+                *t = d->tasks[--d->bottom];
+                found = true;
+        }
+        if (d->bottom == d->top)
+                d->bottom = d->top = 0;
+        pthread_mutex_unlock(&d->lock);
+        return found;
+}
+
+static bool deque_steal(struct deque* d, struct task* t)
+{
+        bool found = false;
+
+        pthread_mutex_lock(&d->lock);
+        if (d->bottom > d->top) {
+                *t = d->tasks[d->top++];
+                found = true;
+        }
+        if (d->bottom == d->top)
+                d->bottom = d->top = 0;
+        pthread_mutex_unlock(&d->lock);
+        return found;
+}
+
+static void report(FILE* out, struct tally* tally, unsigned long games)
+{
+        /* win rate, shots to win and their distribution, as a bar of
+         * density characters */
+        static const char shades[] = " .:-=+*#%@";
+        unsigned long won = 0, most = 0, seen = 0;
+        unsigned long long sum = 0;
+        int p50 = 0, p90 = 0, max = 0;
+        int k;
+
+        for (k=1; k<=MAX_AMMO; k++) {
+                won += tally->won[k];
+                sum += (unsigned long long)k * tally->won[k];
+                if (tally->won[k] > most)
+                        most = tally->won[k];
+                if (tally->won[k])
+                        max = k;
+        }
+        for (k=1; k<=MAX_AMMO; k++) {
+                seen += tally->won[k];
+                if (!p50 && seen * 2 >= won)
+                        p50 = k;
+                if (!p90 && seen * 10 >= won * 9)
+                        p90 = k;
+        }
+
+        fprintf(out, "%6.2f%% %6.2f %4d %4d %4d  ",
+                games ? 100.0 * won / games : 0.0,
+                won ? (double)sum / won : 0.0, p50, p90, max);
+        for (k=1; k<=MAX_AMMO; k++) {
+                if (tally->won[k] == 0)
+                        fputc(' ', out);
+                else
+                        fputc(shades[1 + (tally->won[k] * 8) / most], out);
+        }
+        fputc('\n', out);
+}
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,27 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * The bot evaluator: every strategy of bot.h plays the same games at every
+ * level, on a pool of threads, and the shots each win took are reported.
+ *
+ * The games of a strategy at a level are a task, split in halves as the
+ * threads take it up: a thread works the newest half of its own deque and,
+ * when that is empty, steals the oldest (biggest) one of another thread.
+ * Game number *i* takes its target and its bot choices off seed + i, so
+ * the figures only depend on the seed, never on the threads.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef EVAL_H
+#define EVAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define EVAL_LEVELS 3           /* the levels of ask_options() */
+#define EVAL_GRAIN 256          /* games of a task not split further */
+
+int eval_run(unsigned long games, int threads, uint64_t seed, FILE* out);
+
+#endif /* EVAL_H */
@@ -0,0 +1,122 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Narrowing down the target, see guess.h.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include <limits.h>
+#include <string.h>
+
+#include "guess.h"
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+static int cell_bucket(int a, int b);
+/* -------------------------------------------------------------------------- */
+
+void guess_start(struct guess* g)
+{
+        /* nothing known: the target is where get_new_target() puts it,
+         * the border rows and columns it clamps to coming more often */
+        unsigned short wy[FIELD_HEIGHT] = {0};
+        unsigned short wx[FIELD_WIDTH] = {0};
+        point p;
+        int y, x;
+
+        for (y=0; y<FIELD_HEIGHT-2; y++) {
+                p.y = y;
+                p.x = FIELD_WIDTH / 2;
+                wy[clamp_target(p).y]++;
+        }
+        for (x=0; x<FIELD_WIDTH-4; x++) {
+                p.y = FIELD_HEIGHT / 2;
+                p.x = x;
+                wx[clamp_target(p).x]++;
+        }
+
+        g->n_cand = 0;
+        for (y=0; y<FIELD_HEIGHT; y++) {
+                for (x=0; x<FIELD_WIDTH; x++) {
+                        if (wy[y] && wx[x]) {
+                                g->cand[g->n_cand] = y * FIELD_WIDTH + x;
+                                g->weight[g->n_cand] = wy[y] * wx[x];
+                                g->n_cand++;
+                        }
+                }
+        }
+}
+
+static int cell_bucket(int a, int b)
+{
+        /* the light lit shooting at cell *a* with the target on *b* */
+        point pa, pb;
+
+        pa.y = a / FIELD_WIDTH;
+        pa.x = a % FIELD_WIDTH;
+        pb.y = b / FIELD_WIDTH;
+        pb.x = b % FIELD_WIDTH;
+        return distance_bucket(distance(pa, pb));
+}
+
+void guess_learn(struct guess* g, point shot, int bucket)
+{
+        /* keep the candidates which would have lit *bucket* */
+        int cell = shot.y * FIELD_WIDTH + shot.x;
+        int i, n = 0;
+
+        for (i=0; i<g->n_cand; i++) {
+                if (cell_bucket(cell, g->cand[i]) == bucket) {
+                        g->cand[n] = g->cand[i];
+                        g->weight[n] = g->weight[i];
+                        n++;
+                }
+        }
+        g->n_cand = n;
+}
+
+unsigned long guess_score(struct guess* g, int shooter)
+{
+        /* the weight left shooting at cell *shooter*, on average, times the
+         * weight now: the lower the better, a hit leaves nothing */
+        unsigned long w[N_BUCKETS] = {0};
+        unsigned long score = 0;
+        int i;
+
+        for (i=0; i<g->n_cand; i++)
+                w[cell_bucket(shooter, g->cand[i])] += g->weight[i];
+        for (i=0; i<N_BUCKETS; i++) {
+                if (i != BUCKET_HIT)
+                        score += w[i] * w[i];
+        }
+        return score;
+}
+
+point guess_best(struct guess* g, int max_shooters)
+{
+        /* the candidate splitting the others best, trying an even spread
+         * of *max_shooters* of them (all of them if 0). With no candidate
+         * left -1, -1 comes back */
+        unsigned long score, best = ULONG_MAX;
+        int step = 1;
+        int i, choice = -1;
+        point p;
+
+        if (max_shooters > 0 && g->n_cand > max_shooters)
+                step = g->n_cand / max_shooters;
+        for (i=0; i<g->n_cand; i+=step) {
+                score = guess_score(g, g->cand[i]);
+                if (score < best) {
+                        best = score;
+                        choice = g->cand[i];
+                }
+        }
+        p.y = p.x = -1;
+        if (choice >= 0) {
+                p.y = choice / FIELD_WIDTH;
+                p.x = choice % FIELD_WIDTH;
+        }
+        return p;
+}
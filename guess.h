@@ -0,0 +1,40 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Where the target can be, after some shots and the lamp they lit: every
+ * cell get_new_target() can choose, weighted by how often it does, less
+ * those disagreeing with a bucket seen. guess_best() picks the shot which
+ * splits them best, i.e. leaves the least weight on average unless it hits.
+ *
+ * Only for fields of FIELD_HEIGHT x FIELD_WIDTH, so that a guess fits on
+ * the stack.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef GUESS_H
+#define GUESS_H
+
+#include "engine.h"
+
+#define GUESS_CELLS (FIELD_HEIGHT * FIELD_WIDTH)
+
+/* ---------------------------------------------------------------------------
+ * data structures definition
+ */
+struct guess
+{
+        unsigned short cand[GUESS_CELLS];       /* as field indexes */
+        unsigned short weight[GUESS_CELLS];     /* of each candidate */
+        int n_cand;
+};
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+point guess_best(struct guess* g, int max_shooters);
+void guess_learn(struct guess* g, point shot, int bucket);
+unsigned long guess_score(struct guess* g, int shooter);
+void guess_start(struct guess* g);
+
+#endif /* GUESS_H */
@@ -0,0 +1,52 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Hints, see hints.h.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include "hints.h"
+#include "guess.h"
+
+bool hint_next(game_state* game, point* hint)
+{
+        /* where to shoot next in *game*, in *hint*; false if there is no
+         * telling, i.e. the field is not the usual one or no cell agrees
+         * with the lamp (the target moved?) */
+        struct shot_buf* shots = &game->shots;
+        struct guess g;
+        point shot;
+        int node = 0;
+        int i, cell;
+
+        if (game->height != FIELD_HEIGHT || game->width != FIELD_WIDTH)
+                return false;
+
+        /* follow the tree while the shots are the ones it tells */
+        for (i=game->target_shots; i<shots->len; i++) {
+                cell = shots->y[i] * FIELD_WIDTH + shots->x[i];
+                if (hint_table[node].cell != cell)
+                        break;
+                node = hint_table[node].next[shots->bucket[i]];
+                if (node == 0)
+                        break;
+        }
+        if (i == shots->len) {
+                hint->y = hint_table[node].cell / FIELD_WIDTH;
+                hint->x = hint_table[node].cell % FIELD_WIDTH;
+                return true;
+        }
+
+        /* off the tree: narrow the candidates down here */
+        guess_start(&g);
+        for (i=game->target_shots; i<shots->len; i++) {
+                shot.y = shots->y[i];
+                shot.x = shots->x[i];
+                guess_learn(&g, shot, shots->bucket[i]);
+        }
+        if (g.n_cand == 0)
+                return false;
+        *hint = guess_best(&g, HINT_SHOOTERS);
+        return true;
+}
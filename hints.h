@@ -0,0 +1,44 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Hints: where to shoot next. The answer comes off a decision tree built
+ * at compile time by mkhints (see guess.h for how a shot is chosen), which
+ * is followed with the shots fired at the current target and the lamp
+ * they lit: as long as the player took the hints, a hint is a few table
+ * lookups. Off the tree the candidates are narrowed down on the spot,
+ * trying a sample of HINT_SHOOTERS of them.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef HINTS_H
+#define HINTS_H
+
+#include <stdbool.h>
+
+#include "engine.h"
+
+#define HINT_SHOOTERS 64
+
+/* ---------------------------------------------------------------------------
+ * data structures definition
+ */
+
+/* the shot to take, as a field index, and the node to go to for each
+ * bucket it may light; 0 is none, the root never being next */
+struct hint_node
+{
+        unsigned short cell;
+        unsigned short next[N_BUCKETS];
+};
+
+/* made by mkhints, in hint_table.c */
+extern const struct hint_node hint_table[];
+extern const int hint_nodes;
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+bool hint_next(game_state* game, point* hint);
+
+#endif /* HINTS_H */
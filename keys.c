@@ -0,0 +1,263 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Keys off the terminal, see keys.h.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "keys.h"
+
+/* where the decoder is: the bytes of a sequence seen so far */
+#define GROUND 0        /* none */
+#define ESCAPE 1        /* ESC */
+#define CSI 2           /* ESC [, maybe some arguments */
+#define SS3 3           /* ESC O */
+
+#define ARG_MAX 9999    /* larger arguments stay this */
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+static int csi_key(struct key_reader* k, unsigned char final);
+static int f_key(int n, int mod);
+static int ss3_key(unsigned char final);
+/* -------------------------------------------------------------------------- */
+
+void keys_init(struct key_reader* k)
+{
+        /* nothing read, nothing half decoded */
+        k->len = k->pos = 0;
+        k->state = GROUND;
+        k->arg_i = 0;
+        k->socket = true;
+        k->probing = false;
+}
+
+int keys_feed(struct key_reader* k, int c)
+{
+        /* the key of *c*, off wgetch(): ERR while inside a sequence which
+         * ncurses did not know, decoded as keys_next() does. A key of
+         * ncurses ends such a sequence, and so does ERR a bare ESC, after
+         * which ncurses waited ESCDELAY already. Whatever keys_next() left
+         * must be taken first */
+        if (c == ERR || c > 0xff) {
+                if (k->state != ESCAPE) {
+                        if (c != ERR)
+                                k->state = GROUND;
+                        return c;
+                }
+                k->state = GROUND;
+                if (c != ERR)
+                        ungetch(c);
+                return 27;
+        }
+        k->buf[0] = c;
+        k->len = 1;
+        k->pos = 0;
+        return keys_next(k);
+}
+
+int keys_read(struct key_reader* k, int fd)
+{
+        /* whatever the terminal sent since the last time, in one read(2),
+         * once keys_next() decoded the last batch: the bytes read, 0 if
+         * none are there (or the terminal hung up) and -1 on errors. A
+         * socket is read with MSG_DONTWAIT; a tty, whose O_NONBLOCK would
+         * be its writer's too, is asked by poll(2) first */
+        struct pollfd pfd;
+        ssize_t n = -1;
+
+        if (k->pos < k->len)
+                return k->len - k->pos;
+
+        if (k->socket) {
+                n = recv(fd, k->buf, KEYS_BUF, MSG_DONTWAIT);
+                if (n < 0 && errno == ENOTSOCK)
+                        k->socket = false;
+        }
+        if (!k->socket) {
+                pfd.fd = fd;
+                pfd.events = POLLIN;
+                if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLIN))
+                        return 0;
+                n = read(fd, k->buf, KEYS_BUF);
+        }
+        if (n < 0)
+                return errno == EAGAIN || errno == EINTR ? 0 : -1;
+        k->len = n;
+        k->pos = 0;
+        return n;
+}
+
+int keys_next(struct key_reader* k)
+{
+        /* the next key of the batch read, ERR once it is all decoded: a
+         * sequence it ends inside of is finished by the next batch */
+        unsigned char c;
+        int key;
+
+        while (k->pos < k->len) {
+                c = k->buf[k->pos++];
+                switch (k->state) {
+                case GROUND:
+                        if (c == 27) {
+                                k->state = ESCAPE;
+                                break;
+                        }
+                        if (c == 127 || c == 8)
+                                return KEY_BACKSPACE;
+                        return c;
+
+                case ESCAPE:
+                        if (c == '[') {
+                                k->state = CSI;
+                                k->arg[0] = k->arg[1] = 0;
+                                k->arg_i = 0;
+                                break;
+                        }
+                        if (c == 'O') {
+                                k->state = SS3;
+                                break;
+                        }
+                        /* a bare ESC: *c* is a key of its own */
+                        k->pos--;
+                        k->state = GROUND;
+                        return 27;
+
+                case CSI:
+                        if (c >= '0' && c <= '9') {
+                                key = k->arg_i;
+                                if (key < 2 && k->arg[key] < ARG_MAX)
+                                        k->arg[key] = k->arg[key] * 10 +
+                                                c - '0';
+                                break;
+                        }
+                        if (c == ';') {
+                                if (k->arg_i < 2)
+                                        k->arg_i++;
+                                break;
+                        }
+                        if (c >= 0x20 && c < 0x40)
+                                break;          /* other arguments */
+                        k->state = GROUND;
+                        if (c < 0x20) {
+                                /* not a sequence after all: start over */
+                                k->pos--;
+                                break;
+                        }
+                        if ((key = csi_key(k, c)) != ERR)
+                                return key;
+                        break;
+
+                case SS3:
+                        k->state = GROUND;
+                        if ((key = ss3_key(c)) != ERR)
+                                return key;
+                        break;
+                }
+        }
+        return ERR;
+}
+
+static int csi_key(struct key_reader* k, unsigned char final)
+{
+        /* the key of ESC [ arg ; arg *final*, ERR for those not known */
+        switch (final) {
+        case 'A':
+                return KEY_UP;
+        case 'B':
+                return KEY_DOWN;
+        case 'C':
+                return KEY_RIGHT;
+        case 'D':
+                return KEY_LEFT;
+        case 'H':
+                return KEY_HOME;
+        case 'F':
+                return KEY_END;
+        case 'P':
+        case 'Q':
+        case 'R':
+        case 'S':
+                /* ESC [ row ; col R answers a probe; that of F3 with a
+                 * modifier is ESC [ 1 ; mod R, and there is no telling the
+                 * two apart but by the probe being out */
+                if (final == 'R' && k->probing && k->arg_i == 1)
+                        return KEY_LINK;
+                if (k->arg_i == 0 && k->arg[0] == 0)
+                        return f_key(final - 'P' + 1, 1);
+                if (k->arg_i == 1 && k->arg[0] == 1)
+                        return f_key(final - 'P' + 1, k->arg[1]);
+                return ERR;
+        case '~':
+                switch (k->arg[0]) {
+                case 1:
+                case 7:
+                        return KEY_HOME;
+                case 2:
+                        return KEY_IC;
+                case 3:
+                        return KEY_DC;
+                case 4:
+                case 8:
+                        return KEY_END;
+                case 5:
+                        return KEY_PPAGE;
+                case 6:
+                        return KEY_NPAGE;
+                }
+                return ERR;
+        }
+        return ERR;
+}
+
+static int ss3_key(unsigned char final)
+{
+        /* the key of ESC O *final*, ERR for those not known */
+        switch (final) {
+        case 'A':
+                return KEY_UP;
+        case 'B':
+                return KEY_DOWN;
+        case 'C':
+                return KEY_RIGHT;
+        case 'D':
+                return KEY_LEFT;
+        case 'H':
+                return KEY_HOME;
+        case 'F':
+                return KEY_END;
+        case 'P':
+        case 'Q':
+        case 'R':
+        case 'S':
+                return f_key(final - 'P' + 1, 1);
+        }
+        return ERR;
+}
+
+static int f_key(int n, int mod)
+{
+        /* F*n* with the modifier *mod* of xterm (1 none, 2 shift, 3 alt, 5
+         * control, ...) as the terminfo of xterm numbers it: shift F1 is
+         * F13, control F1 F25 and so on. Those it has none for are F*n* */
+        switch (mod) {
+        case 2:
+                return KEY_F(n + 12);
+        case 5:
+                return KEY_F(n + 24);
+        case 6:
+                return KEY_F(n + 36);
+        case 3:
+                return KEY_F(n + 48);
+        case 4:
+                return KEY_F(n + 60);
+        }
+        return KEY_F(n);
+}
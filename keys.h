@@ -0,0 +1,57 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Keys off the terminal without ncurses. wgetch() reads a key a byte at a
+ * time, a read(2) each, and on an ESC waits up to ESCDELAY for the rest of
+ * the sequence. A key_reader takes whatever the terminal sent in one
+ * read(2), and a small state machine turns it into the keys of ncurses
+ * (KEY_UP, ...): a sequence split over two reads goes on where it was
+ * left, so nothing ever waits on a timeout. A bare ESC is told apart by
+ * the byte after it, whenever that comes.
+ *
+ * Known are the arrows, home/end, insert/delete, page up/down and F1-F4
+ * (shift, alt and control too, as xterm sends them), both as CSI (ESC [)
+ * and SS3 (ESC O, keypad transmit mode) sequences, and the answer to the
+ * probe of struct link (see timing.h); the other sequences are swallowed
+ * whole. keys_feed() decodes the same off wgetch(), which
+ * hands over the bytes of a sequence it does not know one at a time.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef KEYS_H
+#define KEYS_H
+
+#include <ncurses.h>
+
+#define KEYS_BUF 256            /* read at once, at most */
+#define KEY_LINK (KEY_MAX + 1)  /* the cursor report answering a probe */
+
+/* the probe of struct link: the terminal tells where the cursor is, as
+ * ESC [ row ; col R wherever that is. Such an answer comes as KEY_LINK
+ * while key_reader.probing; else it is the F3 of ESC [ 1 ; mod R */
+#define LINK_PROBE "\033[6n"
+
+/* ---------------------------------------------------------------------------
+ * data structures definition
+ */
+struct key_reader
+{
+        unsigned char buf[KEYS_BUF];
+        int len, pos;           /* read, and decoded so far */
+        int state;              /* inside a sequence, see keys.c */
+        int arg[2];             /* of a CSI sequence, the first two */
+        int arg_i;              /* the one being read, 2 for the others */
+        bool socket;            /* the terminal is read with recv() */
+        bool probing;           /* a LINK_PROBE waits for its answer */
+};
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+int keys_feed(struct key_reader* k, int c);
+void keys_init(struct key_reader* k);
+int keys_next(struct key_reader* k);
+int keys_read(struct key_reader* k, int fd);
+
+#endif /* KEYS_H */
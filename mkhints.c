@@ -0,0 +1,123 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Builds the decision tree of hints.h, at compile time: from the root
+ * (nothing known) every node takes the guess_best() shot over all the
+ * candidates left, and has a child for every bucket but a hit which some
+ * candidate would light. The tree is written as C on stdout, hint_table.c,
+ * its size and how many shots it takes to hit on stderr.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "guess.h"
+#include "hints.h"
+
+/* ---------------------------------------------------------------------------
+ * global vars
+ */
+static struct hint_node* nodes;
+static int n_nodes, cap;
+static int max_depth;
+static unsigned long long shots_weight;        /* shots to hit, by weight */
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+static int build(struct guess* g, int depth);
+static int new_node(void);
+/* -------------------------------------------------------------------------- */
+
+int main(void)
+{
+        struct guess g;
+        unsigned long total = 0;
+        int i, b;
+
+        guess_start(&g);
+        for (i=0; i<g.n_cand; i++)
+                total += g.weight[i];
+        build(&g, 1);
+
+        printf("/* generated by mkhints, do not edit: the hints of hints.h "
+               "for a field of\n * %d x %d, %d nodes */\n\n",
+               FIELD_HEIGHT, FIELD_WIDTH, n_nodes);
+        printf("#include \"hints.h\"\n\n");
+        printf("#if FIELD_HEIGHT != %d || FIELD_WIDTH != %d\n",
+               FIELD_HEIGHT, FIELD_WIDTH);
+        printf("#error \"hint_table.c is stale, make it again\"\n#endif\n\n");
+        printf("const int hint_nodes = %d;\n\n", n_nodes);
+        printf("const struct hint_node hint_table[] = {\n");
+        for (i=0; i<n_nodes; i++) {
+                printf("        {%d, {", nodes[i].cell);
+                for (b=0; b<N_BUCKETS; b++)
+                        printf(b ? ", %d" : "%d", nodes[i].next[b]);
+                printf("}},\n");
+        }
+        printf("};\n");
+
+        fprintf(stderr, "mkhints: %d nodes, %zu bytes, hit within %d shots, "
+                "%.2f on average\n", n_nodes,
+                n_nodes * sizeof(struct hint_node), max_depth,
+                (double)shots_weight / total);
+        free(nodes);
+        return 0;
+}
+
+static int new_node(void)
+{
+        struct hint_node* more;
+
+        if (n_nodes == cap) {
+                cap = cap ? 2 * cap : 1024;
+                more = realloc(nodes, cap * sizeof(struct hint_node));
+                if (more == NULL) {
+                        fputs("Memory error.", stderr);
+                        exit(1);
+                }
+                nodes = more;
+        }
+        if (n_nodes > 0xffff) {
+                fputs("mkhints: too many nodes\n", stderr);
+                exit(1);
+        }
+        return n_nodes++;
+}
+
+static int build(struct guess* g, int depth)
+{
+        /* the node for the candidates in *g*, to be shot as the *depth*th
+         * shot, and everything below it */
+        struct guess* rest = malloc(sizeof(struct guess));
+        int node = new_node();
+        point shot = guess_best(g, 0);
+        int i, b, next;
+
+        if (rest == NULL) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        nodes[node].cell = shot.y * FIELD_WIDTH + shot.x;
+
+        for (b=0; b<N_BUCKETS; b++) {
+                *rest = *g;
+                guess_learn(rest, shot, b);
+                next = 0;
+                if (b == BUCKET_HIT) {
+                        /* these are done, with *depth* shots */
+                        for (i=0; i<rest->n_cand; i++)
+                                shots_weight += depth * rest->weight[i];
+                        if (rest->n_cand && depth > max_depth)
+                                max_depth = depth;
+                }
+                else if (rest->n_cand) {
+                        next = build(rest, depth + 1);
+                }
+                nodes[node].next[b] = next;     /* *nodes* may have moved */
+        }
+        free(rest);
+        return node;
+}
@@ -0,0 +1,813 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Render backends, see render.h.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <ncurses.h>
+
+#include "render.h"
+
+#define GRID_LINES 24   /* the workspace of ui.c */
+#define GRID_COLS 80
+#define DIRECT_BUF 16384        /* a frame, but the largest ones */
+#define DIRECT_NONE ((chtype)-1)        /* a cell of struct direct */
+#define DIRECT_WINS 16  /* windows of a session, at most */
+
+/* ---------------------------------------------------------------------------
+ * data structures definition
+ */
+
+/* the screen of render_direct: what the terminal shows and what it is to
+ * show, as chtypes with the color pair in, and the frame going out. A cell
+ * is DIRECT_NONE in front when it is not known, in back when no window
+ * was ever marked over it */
+struct direct
+{
+        chtype front[GRID_LINES * GRID_COLS];
+        chtype back[GRID_LINES * GRID_COLS];
+        bool dirty[GRID_LINES];         /* rows marked since the last frame */
+        bool curses;            /* ncurses sends the screen, see direct_flush() */
+        mtWIN* wins[DIRECT_WINS];       /* the last marked last */
+        int n_wins;
+        int lines, cols;        /* of the workspace on this terminal */
+        int y, x;               /* the cursor, x is -1 when not known */
+        attr_t attr;            /* the SGR attributes set */
+        int fd;
+        size_t len;
+        char out[DIRECT_BUF];
+};
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+static void curses_blank(session* s, mtWIN* win);
+static void curses_delwin(session* s, mtWIN* win);
+static void curses_flush(session* s);
+static void curses_mark(session* s, mtWIN* win);
+static void curses_newwin(session* s, mtWIN* win);
+static void curses_outline(session* s, mtWIN* win, int color);
+static void curses_put(session* s, mtWIN* win, int y, int x, chtype ch,
+                       int color);
+static void curses_putn(session* s, mtWIN* win, int y, int x,
+                        const chtype* chs, int n, int color);
+static void curses_puts(session* s, mtWIN* win, int y, int x,
+                        const char* str, int color);
+static void curses_touch(session* s, mtWIN* win);
+static void direct_attr(struct direct* d, attr_t attr);
+static void direct_blank(session* s, mtWIN* win);
+static void direct_cell(struct direct* d, chtype ch);
+static void direct_close(session* s);
+static void direct_delwin(session* s, mtWIN* win);
+static void direct_emit(struct direct* d, const char* str, size_t len);
+static void direct_flush(session* s);
+static void direct_leave(session* s, struct direct* d);
+static void direct_mark(session* s, mtWIN* win);
+static void direct_move(struct direct* d, int y, int x);
+static void direct_newwin(session* s, mtWIN* win);
+static void direct_open(session* s);
+static void direct_outline(session* s, mtWIN* win, int color);
+static void direct_put(session* s, mtWIN* win, int y, int x, chtype ch,
+                       int color);
+static void direct_putn(session* s, mtWIN* win, int y, int x,
+                        const chtype* chs, int n, int color);
+static void direct_puts(session* s, mtWIN* win, int y, int x,
+                        const char* str, int color);
+static void direct_row(struct direct* d, int y);
+static void direct_send(struct direct* d);
+static struct direct* direct_session(session* s);
+static void direct_touch(session* s, mtWIN* win);
+static void grid_blank(session* s, mtWIN* win);
+static void grid_close(session* s);
+static void grid_delwin(session* s, mtWIN* win);
+static void grid_flush(session* s);
+static void grid_mark(session* s, mtWIN* win);
+static void grid_newwin(session* s, mtWIN* win);
+static void grid_open(session* s);
+static void grid_outline(session* s, mtWIN* win, int color);
+static void grid_put(session* s, mtWIN* win, int y, int x, chtype ch,
+                     int color);
+static void grid_putn(session* s, mtWIN* win, int y, int x,
+                      const chtype* chs, int n, int color);
+static void grid_puts(session* s, mtWIN* win, int y, int x,
+                      const char* str, int color);
+static void nop_session(session* s);
+static void nop_win(session* s, mtWIN* win);
+static void null_outline(session* s, mtWIN* win, int color);
+static void null_put(session* s, mtWIN* win, int y, int x, chtype ch,
+                     int color);
+static void null_putn(session* s, mtWIN* win, int y, int x,
+                      const chtype* chs, int n, int color);
+static void null_puts(session* s, mtWIN* win, int y, int x,
+                      const char* str, int color);
+/* -------------------------------------------------------------------------- */
+
+const struct render_ops render_curses = {
+        "ncurses",
+        nop_session, nop_session,
+        curses_newwin, curses_delwin,
+        curses_put, curses_puts, curses_putn, curses_blank, curses_outline,
+        curses_mark, curses_touch, curses_flush,
+};
+
+const struct render_ops render_direct = {
+        "direct",
+        direct_open, direct_close,
+        direct_newwin, direct_delwin,
+        direct_put, direct_puts, direct_putn, direct_blank, direct_outline,
+        direct_mark, direct_touch, direct_flush,
+};
+
+const struct render_ops render_null = {
+        "null",
+        nop_session, nop_session,
+        nop_win, nop_win,
+        null_put, null_puts, null_putn, nop_win, null_outline,
+        nop_win, nop_win, nop_session,
+};
+
+const struct render_ops render_grid = {
+        "grid",
+        grid_open, grid_close,
+        grid_newwin, grid_delwin,
+        grid_put, grid_puts, grid_putn, grid_blank, grid_outline,
+        grid_mark, nop_win, grid_flush,
+};
+
+static void nop_session(session* s)
+{
+}
+
+static void nop_win(session* s, mtWIN* win)
+{
+}
+
+/* ---------------------------------------------------------------------------
+ * ncurses: the session's SCREEN is the current one, see enter_ncurses()
+ */
+static void curses_newwin(session* s, mtWIN* win)
+{
+        if (win->win != NULL)
+                return;         /* a window kept, see reuse_win() */
+        win->win = newwin(win->height, win->width, win->y, win->x);
+        keypad(win->win, TRUE);
+}
+
+static void curses_delwin(session* s, mtWIN* win)
+{
+        if (win->win != NULL)
+                delwin(win->win);
+}
+
+static void curses_put(session* s, mtWIN* win, int y, int x, chtype ch,
+                       int color)
+{
+        if (ch & A_ALTCHARSET)
+                ch = NCURSES_ACS(ch & A_CHARTEXT);
+        if (s->term_colors && color) wattron(win->win, COLOR_PAIR(color));
+        mvwaddch(win->win, y, x, ch);
+        if (s->term_colors && color) wattroff(win->win, COLOR_PAIR(color));
+}
+
+static void curses_puts(session* s, mtWIN* win, int y, int x,
+                        const char* str, int color)
+{
+        if (s->term_colors && color) wattron(win->win, COLOR_PAIR(color));
+        mvwaddstr(win->win, y, x, str);
+        if (s->term_colors && color) wattroff(win->win, COLOR_PAIR(color));
+}
+
+static void curses_putn(session* s, mtWIN* win, int y, int x,
+                        const chtype* chs, int n, int color)
+{
+        /* the cells go in with one copy, color and all, as waddchnstr()
+         * takes them as they are */
+        chtype row[GRID_COLS];
+        chtype pair = s->term_colors && color ? COLOR_PAIR(color) : 0;
+        int i;
+
+        if (n > GRID_COLS)
+                n = GRID_COLS;
+        for (i=0; i<n; i++) {
+                row[i] = chs[i] & A_ALTCHARSET ?
+                        NCURSES_ACS(chs[i] & A_CHARTEXT) : chs[i];
+                row[i] |= pair;
+        }
+        mvwaddchnstr(win->win, y, x, row, n);
+}
+
+static void curses_blank(session* s, mtWIN* win)
+{
+        werase(win->win);
+}
+
+static void curses_outline(session* s, mtWIN* win, int color)
+{
+        if (color) {
+                if (s->term_colors) wattron(win->win, COLOR_PAIR(color));
+                box(win->win, 0, 0);
+                if (s->term_colors) wattroff(win->win, COLOR_PAIR(color));
+        }
+        else {  /* hide border */
+                wborder(win->win, ' ', ' ', ' ',' ',' ',' ',' ',' ');
+        }
+}
+
+static void curses_mark(session* s, mtWIN* win)
+{
+        wnoutrefresh(win->win);
+}
+
+static void curses_touch(session* s, mtWIN* win)
+{
+        touchwin(win->win);
+}
+
+static void curses_flush(session* s)
+{
+        /* one doupdate(), which ncurses sends in one write, see
+         * enter_ncurses() in ui.c */
+        doupdate();
+}
+
+/* ---------------------------------------------------------------------------
+ * direct: the cells of every window, put together and sent from here
+ */
+static void direct_open(session* s)
+{
+        /* only for the terminals which take ANSI sequences, as xterm and
+         * the like: on the others ncurses goes on on its own */
+        const char* cup = tigetstr("cup");
+        struct direct* d;
+        int i;
+
+        if (cup == NULL || cup == (char*)-1 || strncmp(cup, "\033[", 2)) {
+                s->render = &render_curses;
+                return;
+        }
+
+        d = calloc(1, sizeof(struct direct));
+        if (d == NULL) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        d->lines = LINES < GRID_LINES ? LINES : GRID_LINES;
+        d->cols = COLS < GRID_COLS ? COLS : GRID_COLS;
+        d->fd = s->out_fd;
+        d->curses = TRUE;
+        for (i=0; i<GRID_LINES * GRID_COLS; i++)
+                d->front[i] = d->back[i] = DIRECT_NONE;
+        s->render_data = d;
+}
+
+static void direct_close(session* s)
+{
+        free(s->render_data);
+        s->render_data = NULL;
+}
+
+static struct direct* direct_session(session* s)
+{
+        /* the screen of *s*, given back to ncurses if the game is over */
+        struct direct* d = s->render_data;
+
+        if (!d->curses && s->at != AT_PLAY)
+                direct_leave(s, d);
+        return d;
+}
+
+static void direct_newwin(session* s, mtWIN* win)
+{
+        /* the ncurses window, and the cells of our own */
+        struct direct* d = direct_session(s);
+        int i;
+
+        if (d->n_wins == DIRECT_WINS) {
+                fputs("Too many windows.", stderr);
+                exit(1);
+        }
+        curses_newwin(s, win);
+        win->cells = malloc(win->height * win->width *
+                            sizeof(struct grid_cell));
+        if (win->cells == NULL) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        for (i=0; i<win->height * win->width; i++)
+                win->cells[i].ch = ' ';
+        d->wins[d->n_wins++] = win;
+}
+
+static void direct_delwin(session* s, mtWIN* win)
+{
+        struct direct* d = direct_session(s);
+        int i;
+
+        for (i=0; i<d->n_wins && d->wins[i] != win; i++)
+                ;
+        if (i < d->n_wins)
+                memmove(&d->wins[i], &d->wins[i+1],
+                        (--d->n_wins - i) * sizeof(mtWIN*));
+        curses_delwin(s, win);
+        free(win->cells);
+        win->cells = NULL;
+}
+
+static void direct_put(session* s, mtWIN* win, int y, int x, chtype ch,
+                       int color)
+{
+        /* the cell keeps *ch* as it is to be sent: the line drawing
+         * characters as LINE_CH(), the color pair in. The ncurses window
+         * gets it only while ncurses sends the screen */
+        if (direct_session(s)->curses)
+                curses_put(s, win, y, x, ch, color);
+        if (y < 0 || x < 0 || y >= win->height || x >= win->width)
+                return;
+        if (s->term_colors && color)
+                ch |= COLOR_PAIR(color);
+        win->cells[y * win->width + x].ch = ch;
+}
+
+static void direct_puts(session* s, mtWIN* win, int y, int x,
+                        const char* str, int color)
+{
+        chtype pair = s->term_colors && color ? COLOR_PAIR(color) : 0;
+        struct grid_cell* c;
+
+        if (direct_session(s)->curses)
+                curses_puts(s, win, y, x, str, color);
+        if (y < 0 || x < 0 || y >= win->height)
+                return;
+        c = &win->cells[y * win->width];
+        while (*str && x < win->width)
+                c[x++].ch = (unsigned char)*str++ | pair;
+}
+
+static void direct_putn(session* s, mtWIN* win, int y, int x,
+                        const chtype* chs, int n, int color)
+{
+        chtype pair = s->term_colors && color ? COLOR_PAIR(color) : 0;
+        struct grid_cell* c;
+
+        if (direct_session(s)->curses)
+                curses_putn(s, win, y, x, chs, n, color);
+        if (y < 0 || x < 0 || y >= win->height)
+                return;
+        c = &win->cells[y * win->width];
+        while (n-- > 0 && x < win->width)
+                c[x++].ch = *chs++ | pair;
+}
+
+static void direct_blank(session* s, mtWIN* win)
+{
+        int i;
+
+        if (direct_session(s)->curses)
+                curses_blank(s, win);
+        for (i=0; i<win->height * win->width; i++)
+                win->cells[i].ch = ' ';
+}
+
+static void direct_outline(session* s, mtWIN* win, int color)
+{
+        /* the box of curses_outline(), or blanks where it was */
+        chtype pair = s->term_colors && color ? COLOR_PAIR(color) : 0;
+        struct grid_cell* c = win->cells;
+        int bottom = win->height-1;
+        int right = win->width-1;
+        int i;
+
+        if (direct_session(s)->curses)
+                curses_outline(s, win, color);
+        for (i=1; i<right; i++)
+                c[i].ch = c[bottom * win->width + i].ch =
+                        (color ? LINE_HLINE : ' ') | pair;
+        for (i=1; i<bottom; i++)
+                c[i * win->width].ch = c[i * win->width + right].ch =
+                        (color ? LINE_VLINE : ' ') | pair;
+        c[0].ch = (color ? LINE_ULCORNER : ' ') | pair;
+        c[right].ch = (color ? LINE_URCORNER : ' ') | pair;
+        c[bottom * win->width].ch = (color ? LINE_LLCORNER : ' ') | pair;
+        c[bottom * win->width + right].ch =
+                (color ? LINE_LRCORNER : ' ') | pair;
+}
+
+static void direct_mark(session* s, mtWIN* win)
+{
+        /* copy the cells of *win* on the back buffer, where it stands on
+         * the screen, and put it last among the windows. ncurses takes
+         * the window too while it sends the screen: see direct_flush() */
+        struct direct* d = direct_session(s);
+        int i, y, x;
+
+        if (d->curses)
+                curses_mark(s, win);
+        for (i=0; i<d->n_wins && d->wins[i] != win; i++)
+                ;
+        if (i < d->n_wins) {
+                memmove(&d->wins[i], &d->wins[i+1],
+                        (d->n_wins-1 - i) * sizeof(mtWIN*));
+                d->wins[d->n_wins-1] = win;
+        }
+        for (y=0; y<win->height && win->y + y < d->lines; y++) {
+                for (x=0; x<win->width && win->x + x < d->cols; x++)
+                        d->back[(win->y + y) * GRID_COLS + win->x + x] =
+                                win->cells[y * win->width + x].ch;
+                d->dirty[win->y + y] = TRUE;
+        }
+}
+
+static void direct_flush(session* s)
+{
+        /* the rows marked since the last frame are diffed with what the
+         * terminal shows, and what differs is sent with one write. Out of
+         * a game, and for its first frame, ncurses sends the screen
+         * instead: the greeting and the options are drawn there, so what
+         * the terminal shows is known to ncurses only. From then on it is
+         * the other way round, and the windows are drawn here only:
+         * clearok() has ncurses repaint the whole screen the next time it
+         * sends it, which tells us it did, see direct_leave() */
+        struct direct* d = direct_session(s);
+        int i, y;
+
+        if (d->curses) {
+                curses_flush(s);
+                memset(d->dirty, 0, sizeof(d->dirty));
+                if (s->at == AT_PLAY) {
+                        memcpy(d->front, d->back, sizeof(d->front));
+                        clearok(curscr, TRUE);
+                        d->curses = FALSE;
+                }
+                return;
+        }
+        if (!is_cleared(curscr)) {
+                /* ncurses sent something all the same: resend it all */
+                for (i=0; i<GRID_LINES * GRID_COLS; i++)
+                        d->front[i] = DIRECT_NONE;
+                memset(d->dirty, TRUE, sizeof(d->dirty));
+                clearok(curscr, TRUE);
+        }
+
+        d->x = -1;
+        d->attr = A_NORMAL;
+        d->len = 0;
+        for (y=0; y<d->lines; y++) {
+                if (d->dirty[y])
+                        direct_row(d, y);
+                d->dirty[y] = FALSE;
+        }
+        if (d->len) {
+                direct_attr(d, A_NORMAL);
+                direct_send(d);
+        }
+}
+
+static void direct_leave(session* s, struct direct* d)
+{
+        /* ncurses takes the screen back, out of a game: its windows get
+         * the cells drawn since, and go on its screen in the order they
+         * were last marked. What the terminal shows being known to us
+         * only, ncurses repaints it whole the next time it sends it */
+        chtype row[GRID_COLS];
+        struct grid_cell* c;
+        mtWIN* win;
+        int i, y, x, n;
+
+        for (i=0; i<d->n_wins; i++) {
+                win = d->wins[i];
+                n = win->width < GRID_COLS ? win->width : GRID_COLS;
+                for (y=0; y<win->height; y++) {
+                        c = &win->cells[y * win->width];
+                        for (x=0; x<n; x++)
+                                row[x] = c[x].ch & A_ALTCHARSET ?
+                                        NCURSES_ACS(c[x].ch & A_CHARTEXT) |
+                                        (c[x].ch & A_COLOR) : c[x].ch;
+                        mvwaddchnstr(win->win, y, 0, row, n);
+                }
+                touchwin(win->win);
+                wnoutrefresh(win->win);
+        }
+        clearok(curscr, TRUE);
+        d->curses = TRUE;
+}
+
+static void direct_touch(session* s, mtWIN* win)
+{
+        /* the cells of a window are all taken by direct_mark() anyway */
+        if (direct_session(s)->curses)
+                curses_touch(s, win);
+}
+
+static void direct_row(struct direct* d, int y)
+{
+        /* send the cells of row *y* which changed: over a few unchanged
+         * ones in the same attributes the cursor goes writing them again,
+         * else it jumps */
+        chtype* front = &d->front[y * GRID_COLS];
+        chtype* back = &d->back[y * GRID_COLS];
+        int x, i;
+
+        for (x=0; x<d->cols; x++) {
+                if (back[x] == DIRECT_NONE || front[x] == back[x])
+                        continue;
+                if (y == LINES-1 && x == COLS-1)
+                        continue;       /* writing there may scroll */
+
+                if (d->y == y && d->x >= 0 && d->x < x && x - d->x < 4) {
+                        for (i=d->x; i<x; i++) {
+                                if ((back[i] & A_ATTRIBUTES) != d->attr)
+                                        break;
+                        }
+                        if (i < x)
+                                direct_move(d, y, x);
+                        for (; d->x < x; )
+                                direct_cell(d, back[d->x]);
+                }
+                else if (d->y != y || d->x != x) {
+                        direct_move(d, y, x);
+                }
+                direct_cell(d, back[x]);
+                front[x] = back[x];
+        }
+}
+
+static void direct_move(struct direct* d, int y, int x)
+{
+        /* the cursor to *y*, *x*: forward on the same row, else anywhere */
+        char seq[32];           /* ESC [, two ints, ; and H */
+        int n;
+
+        if (d->y == y && d->x >= 0 && d->x < x)
+                n = x - d->x == 1 ? snprintf(seq, sizeof(seq), "\033[C") :
+                        snprintf(seq, sizeof(seq), "\033[%dC", x - d->x);
+        else
+                n = snprintf(seq, sizeof(seq), "\033[%d;%dH",
+                             y + 1, x + 1);
+        direct_emit(d, seq, n);
+        d->y = y;
+        d->x = x;
+}
+
+static void direct_cell(struct direct* d, chtype ch)
+{
+        /* write *ch* where the cursor is, which moves right */
+        char c = ch & A_CHARTEXT;
+
+        direct_attr(d, ch & A_ATTRIBUTES);
+        if (c == 0)
+                c = ' ';
+        direct_emit(d, &c, 1);
+        if (++d->x >= COLS)
+                d->x = -1;      /* at the margin, the terminal knows where */
+}
+
+static void direct_attr(struct direct* d, attr_t attr)
+{
+        /* set the attributes *attr*, if not yet: the line drawing
+         * characters are the G0 charset switched to the DEC graphics */
+        char seq[32];
+        short fg, bg;
+        int n;
+
+        if ((attr ^ d->attr) & A_ALTCHARSET)
+                direct_emit(d, attr & A_ALTCHARSET ? "\033(0" : "\033(B", 3);
+        if ((attr ^ d->attr) & ~A_ALTCHARSET) {
+                n = sprintf(seq, "\033[0");
+                if (attr & A_BOLD)
+                        n += sprintf(seq + n, ";1");
+                if (attr & A_DIM)
+                        n += sprintf(seq + n, ";2");
+                if (attr & A_UNDERLINE)
+                        n += sprintf(seq + n, ";4");
+                if (attr & A_BLINK)
+                        n += sprintf(seq + n, ";5");
+                if (attr & (A_REVERSE | A_STANDOUT))
+                        n += sprintf(seq + n, ";7");
+                if (pair_content(PAIR_NUMBER(attr), &fg, &bg) == OK) {
+                        if (fg >= 0 && fg < 8)
+                                n += sprintf(seq + n, ";3%d", fg);
+                        if (bg >= 0 && bg < 8)
+                                n += sprintf(seq + n, ";4%d", bg);
+                }
+                n += sprintf(seq + n, "m");
+                direct_emit(d, seq, n);
+        }
+        d->attr = attr;
+}
+
+static void direct_emit(struct direct* d, const char* str, size_t len)
+{
+        if (len > DIRECT_BUF - d->len)
+                direct_send(d);         /* only a frame redrawing a lot */
+        memcpy(d->out + d->len, str, len);
+        d->len += len;
+}
+
+static void direct_send(struct direct* d)
+{
+        /* the frame so far, in one write */
+        const char* p = d->out;
+        ssize_t n;
+
+        while (d->len) {
+                n = write(d->fd, p, d->len);
+                if (n < 0 && errno != EINTR)
+                        break;  /* the terminal is gone: session_wait() */
+                if (n > 0) {
+                        p += n;
+                        d->len -= n;
+                }
+        }
+        d->len = 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * null: nothing at all
+ */
+static void null_put(session* s, mtWIN* win, int y, int x, chtype ch,
+                     int color)
+{
+}
+
+static void null_puts(session* s, mtWIN* win, int y, int x,
+                      const char* str, int color)
+{
+}
+
+static void null_putn(session* s, mtWIN* win, int y, int x,
+                      const chtype* chs, int n, int color)
+{
+}
+
+static void null_outline(session* s, mtWIN* win, int color)
+{
+}
+
+/* ---------------------------------------------------------------------------
+ * grid: the cells of every window, copied onto the screen by refresh()
+ */
+static void grid_open(session* s)
+{
+        struct grid* g = calloc(1, sizeof(struct grid));
+        int i;
+
+        if (g != NULL)
+                g->cells = malloc(GRID_LINES * GRID_COLS *
+                                  sizeof(struct grid_cell));
+        if (g == NULL || g->cells == NULL) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        g->height = GRID_LINES;
+        g->width = GRID_COLS;
+        s->render_data = g;
+
+        for (i=0; i<GRID_LINES * GRID_COLS; i++) {
+                g->cells[i].ch = ' ';
+                g->cells[i].color = 0;
+        }
+}
+
+static void grid_close(session* s)
+{
+        struct grid* g = s->render_data;
+
+        free(g->cells);
+        free(g);
+        s->render_data = NULL;
+}
+
+static void grid_newwin(session* s, mtWIN* win)
+{
+        win->cells = malloc(win->height * win->width *
+                            sizeof(struct grid_cell));
+        if (win->cells == NULL) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        grid_blank(s, win);
+}
+
+static void grid_delwin(session* s, mtWIN* win)
+{
+        free(win->cells);
+        win->cells = NULL;
+}
+
+static void grid_put(session* s, mtWIN* win, int y, int x, chtype ch,
+                     int color)
+{
+        struct grid_cell* c;
+
+        if (y < 0 || x < 0 || y >= win->height || x >= win->width)
+                return;
+
+        /* line drawing characters in plain ASCII, as a dumb terminal
+         * would show them, see LINE_CH() */
+        if (ch & A_ALTCHARSET) {
+                switch (ch & A_CHARTEXT) {
+                case 'q':
+                        ch = '-';
+                        break;
+                case 'x':
+                        ch = '|';
+                        break;
+                default:
+                        ch = '+';
+                        break;
+                }
+        }
+        c = &win->cells[y * win->width + x];
+        c->ch = ch;
+        c->color = color;
+}
+
+static void grid_puts(session* s, mtWIN* win, int y, int x,
+                      const char* str, int color)
+{
+        while (*str && x < win->width)
+                grid_put(s, win, y, x++, (unsigned char)*str++, color);
+}
+
+static void grid_putn(session* s, mtWIN* win, int y, int x,
+                      const chtype* chs, int n, int color)
+{
+        while (n-- > 0)
+                grid_put(s, win, y, x++, *chs++, color);
+}
+
+static void grid_blank(session* s, mtWIN* win)
+{
+        int i;
+
+        for (i=0; i<win->height * win->width; i++) {
+                win->cells[i].ch = ' ';
+                win->cells[i].color = 0;
+        }
+}
+
+static void grid_outline(session* s, mtWIN* win, int color)
+{
+        int bottom = win->height-1;
+        int right = win->width-1;
+        chtype hch = color ? '-' : ' ';
+        chtype vch = color ? '|' : ' ';
+        chtype corner = color ? '+' : ' ';
+        int i;
+
+        for (i=1; i<right; i++) {
+                grid_put(s, win, 0, i, hch, color);
+                grid_put(s, win, bottom, i, hch, color);
+        }
+        for (i=1; i<bottom; i++) {
+                grid_put(s, win, i, 0, vch, color);
+                grid_put(s, win, i, right, vch, color);
+        }
+        grid_put(s, win, 0, 0, corner, color);
+        grid_put(s, win, 0, right, corner, color);
+        grid_put(s, win, bottom, 0, corner, color);
+        grid_put(s, win, bottom, right, corner, color);
+}
+
+static void grid_mark(session* s, mtWIN* win)
+{
+        /* copy *win* where it stands on the screen, counting what changed */
+        struct grid* g = s->render_data;
+        struct grid_cell* src;
+        struct grid_cell* dst;
+        int y, x;
+
+        for (y=0; y<win->height && win->y + y < g->height; y++) {
+                src = &win->cells[y * win->width];
+                dst = &g->cells[(win->y + y) * g->width + win->x];
+                for (x=0; x<win->width && win->x + x < g->width; x++) {
+                        if (dst[x].ch != src[x].ch ||
+                            dst[x].color != src[x].color) {
+                                dst[x] = src[x];
+                                g->cells_changed++;
+                        }
+                }
+        }
+}
+
+static void grid_flush(session* s)
+{
+        struct grid* g = s->render_data;
+
+        g->frames++;
+}
+
+struct grid_cell grid_cell(session* s, int y, int x)
+{
+        /* what the screen of a render_grid session shows at *y*, *x* */
+        struct grid* g = s->render_data;
+
+        return g->cells[y * g->width + x];
+}
@@ -0,0 +1,104 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Render backends: what the front-end draws goes through one of these, so
+ * that the game screens can be driven with no terminal at all.
+ *
+ *  - render_curses: the ncurses windows, the real thing;
+ *  - render_direct: the frames of a game are sent from here: the windows
+ *    keep cells of their own, marking them copies them on a back buffer,
+ *    which is diffed with a front buffer of what was sent, and the cells
+ *    which differ go out as ANSI sequences in one write. In a game ncurses
+ *    sets up the terminal and nothing else; out of one the greeting and
+ *    the options are its, and its windows are drawn too, having been
+ *    given the cells of the game when it took the screen back. For the
+ *    terminals which take those sequences, else it is render_curses;
+ *  - render_null: draws nothing, for throughput runs of the game logic;
+ *  - render_grid: an in-memory terminal, every window a grid of cells
+ *    copied onto a 24x80 screen as it is marked, which can be looked at
+ *    with grid_cell(); line drawing characters come out as plain ASCII.
+ *
+ * Colors are the color pairs of ui.c, 0 being none. Line drawing characters
+ * are given as LINE_*, for the ACS_* of ncurses are only known once it has
+ * set up a terminal.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <ncurses.h>
+
+#include "ui.h"
+
+/* the VT100 line drawing character *c*, for any backend */
+#define LINE_CH(c) (A_ALTCHARSET | (c))
+#define LINE_HLINE LINE_CH('q')
+#define LINE_VLINE LINE_CH('x')
+#define LINE_ULCORNER LINE_CH('l')
+#define LINE_URCORNER LINE_CH('k')
+#define LINE_LLCORNER LINE_CH('m')
+#define LINE_LRCORNER LINE_CH('j')
+#define LINE_TTEE LINE_CH('w')
+#define LINE_BTEE LINE_CH('v')
+
+/* ---------------------------------------------------------------------------
+ * data structures definition
+ */
+struct render_ops
+{
+        const char* name;
+
+        /* per session setup, before the first window */
+        void (*open)(session* s);
+        void (*close)(session* s);
+
+        /* *win* comes with its size and place filled in, and with the
+         * ncurses window kept for it if any, see reuse_win() in ui.c */
+        void (*newwin)(session* s, mtWIN* win);
+        void (*delwin)(session* s, mtWIN* win);
+
+        void (*put)(session* s, mtWIN* win, int y, int x, chtype ch,
+                    int color);
+        void (*puts)(session* s, mtWIN* win, int y, int x, const char* str,
+                     int color);
+        /* *n* cells of a row at once, see blit() in ui.c */
+        void (*putn)(session* s, mtWIN* win, int y, int x, const chtype* chs,
+                     int n, int color);
+        void (*blank)(session* s, mtWIN* win);
+        void (*outline)(session* s, mtWIN* win, int color);
+
+        /* mark() takes what changed in a window into the next frame,
+         * touch() all of it, flush() sends the frame */
+        void (*mark)(session* s, mtWIN* win);
+        void (*touch)(session* s, mtWIN* win);
+        void (*flush)(session* s);
+};
+
+struct grid_cell
+{
+        chtype ch;
+        short color;
+};
+
+/* the screen of render_grid */
+struct grid
+{
+        int height, width;
+        struct grid_cell* cells;
+        unsigned long frames;           /* flush() calls */
+        unsigned long cells_changed;    /* by all of them */
+};
+
+extern const struct render_ops render_curses;
+extern const struct render_ops render_direct;
+extern const struct render_ops render_null;
+extern const struct render_ops render_grid;
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+struct grid_cell grid_cell(session* s, int y, int x);
+
+#endif /* RENDER_H */
@@ -0,0 +1,367 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Game recordings, see replay.h for the file format.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "replay.h"
+
+#define MAGIC_LEN (sizeof(REPLAY_MAGIC) - 1)
+#define MAX_RECORD 32   /* the longest record, a 'G' takes 15 + name */
+
+/* ----------------------------------------------------------------------------
+ * writer
+ */
+static void put_byte(struct replay_writer* w, unsigned int v)
+{
+        w->buf[w->len++] = v;
+}
+
+static void put_u16(struct replay_writer* w, unsigned int v)
+{
+        put_byte(w, v & 0xff);
+        put_byte(w, v >> 8 & 0xff);
+}
+
+static void put_u64(struct replay_writer* w, uint64_t v)
+{
+        int i;
+
+        for (i=0; i<8; i++)
+                put_byte(w, v >> (i*8) & 0xff);
+}
+
+static void put_dt(struct replay_writer* w, uint64_t now_ms)
+{
+        /* the time since the previous record, as a LEB128 varint */
+        uint64_t dt = now_ms - w->last_ms;
+        unsigned int v = dt > UINT32_MAX ? UINT32_MAX : dt;
+
+        w->last_ms = now_ms;
+        while (v >= 0x80) {
+                put_byte(w, (v & 0x7f) | 0x80);
+                v >>= 7;
+        }
+        put_byte(w, v);
+}
+
+static void room(struct replay_writer* w)
+{
+        /* make sure the next record fits in the buffer */
+        if (w->len + MAX_RECORD > REPLAY_BUF)
+                replay_flush(w);
+}
+
+struct replay_writer* replay_writer_open(const char* path)
+{
+        /* append to the recording in *path*, creating it if needed */
+        struct replay_writer* w;
+        char magic[MAGIC_LEN];
+        off_t size;
+        int fd;
+
+        fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0)
+                return NULL;
+        size = lseek(fd, 0, SEEK_END);
+        if (size > 0 && (pread(fd, magic, MAGIC_LEN, 0) != MAGIC_LEN ||
+                         memcmp(magic, REPLAY_MAGIC, MAGIC_LEN) != 0)) {
+                close(fd);
+                errno = EINVAL;
+                return NULL;
+        }
+
+        w = calloc(1, sizeof(struct replay_writer));
+        if (!w) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        w->fd = fd;
+        if (size == 0) {
+                memcpy(w->buf, REPLAY_MAGIC, MAGIC_LEN);
+                w->len = MAGIC_LEN;
+        }
+        return w;
+}
+
+void replay_writer_close(struct replay_writer* w)
+{
+        replay_flush(w);
+        close(w->fd);
+        free(w);
+}
+
+void replay_flush(struct replay_writer* w)
+{
+        /* on a write error the buffered records are lost, the game
+         * goes on */
+        size_t done = 0;
+        ssize_t n;
+
+        while (done < w->len) {
+                n = write(w->fd, w->buf + done, w->len - done);
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n <= 0)
+                        break;
+                done += n;
+        }
+        w->len = 0;
+}
+
+void replay_game(struct replay_writer* w, game_conf* conf, int height,
+                 int width, uint64_t now_ms)
+{
+        room(w);
+        put_byte(w, REPLAY_GAME);
+        put_u64(w, conf->seed);
+        put_byte(w, conf->level);
+        put_byte(w, conf->timer);
+        put_u16(w, height);
+        put_u16(w, width);
+        memcpy(w->buf + w->len, conf->player_name, MAX_PN_LEN);
+        w->buf[w->len + MAX_PN_LEN-1] = '\0';
+        w->len += MAX_PN_LEN;
+        w->last_ms = now_ms;
+}
+
+void replay_input(struct replay_writer* w, int input, uint64_t now_ms)
+{
+        room(w);
+        put_byte(w, input);
+        put_dt(w, now_ms);
+}
+
+void replay_end(struct replay_writer* w, game_state* game, uint64_t now_ms)
+{
+        /* close the game record, and send it all to the file */
+        room(w);
+        put_byte(w, REPLAY_END);
+        put_dt(w, now_ms);
+        put_byte(w, game->status);
+        put_byte(w, game->ammo_left);
+        put_u16(w, game->target.y);
+        put_u16(w, game->target.x);
+        replay_flush(w);
+}
+
+/* ----------------------------------------------------------------------------
+ * reader
+ */
+static int get_bytes(struct replay* r, const unsigned char** p, size_t n)
+{
+        if (r->size - r->pos < n)
+                return -1;
+        *p = r->data + r->pos;
+        r->pos += n;
+        return 0;
+}
+
+static int get_dt(struct replay* r, unsigned int* dt)
+{
+        unsigned int v = 0;
+        int shift;
+
+        for (shift=0; shift<35; shift+=7) {
+                if (r->pos == r->size)
+                        return -1;
+                v |= (unsigned int)(r->data[r->pos] & 0x7f) << shift;
+                if (!(r->data[r->pos++] & 0x80)) {
+                        *dt = v;
+                        return 0;
+                }
+        }
+        return -1;
+}
+
+int replay_open(struct replay* r, const char* path)
+{
+        struct stat st;
+        void* data;
+        int fd;
+
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+                return -1;
+        if (fstat(fd, &st) < 0 || (size_t)st.st_size < MAGIC_LEN) {
+                close(fd);
+                errno = EINVAL;
+                return -1;
+        }
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+                return -1;
+        if (memcmp(data, REPLAY_MAGIC, MAGIC_LEN) != 0) {
+                munmap(data, st.st_size);
+                errno = EINVAL;
+                return -1;
+        }
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+        r->data = data;
+        r->size = st.st_size;
+        r->pos = r->last = MAGIC_LEN;
+        return 0;
+}
+
+void replay_close(struct replay* r)
+{
+        munmap((void*)r->data, r->size);
+        r->data = NULL;
+}
+
+int replay_next(struct replay* r, struct replay_rec* rec)
+{
+        /* read the next record into *rec*: 1 when there is one, 0 at the
+         * end of the file and -1 if it is cut or garbled */
+        const unsigned char* p;
+        int i;
+
+        r->last = r->pos;
+        if (r->pos == r->size)
+                return 0;
+
+        rec->type = r->data[r->pos++];
+        switch (rec->type) {
+        case REPLAY_GAME:
+                if (get_bytes(r, &p, 14 + MAX_PN_LEN) < 0)
+                        return -1;
+                rec->conf.seed = 0;
+                for (i=7; i>=0; i--)
+                        rec->conf.seed = rec->conf.seed << 8 | p[i];
+                rec->conf.level = p[8];
+                rec->conf.timer = p[9];
+                rec->height = p[10] | p[11] << 8;
+                rec->width = p[12] | p[13] << 8;
+                memcpy(rec->conf.player_name, p + 14, MAX_PN_LEN);
+                rec->conf.player_name[MAX_PN_LEN-1] = '\0';
+                rec->dt = 0;
+                /* the same bounds as --field, a game never gets any other */
+                if (rec->conf.level < 1 || rec->conf.level > LEVEL_PRACTICE ||
+                    rec->height < FIELD_HEIGHT || rec->height > FIELD_MAX ||
+                    rec->width < FIELD_WIDTH || rec->width > FIELD_MAX)
+                        return -1;
+                return 1;
+        case REPLAY_END:
+                if (get_dt(r, &rec->dt) < 0 || get_bytes(r, &p, 6) < 0)
+                        return -1;
+                rec->status = p[0];
+                rec->ammo_left = p[1];
+                rec->target.y = p[2] | p[3] << 8;
+                rec->target.x = p[4] | p[5] << 8;
+                return 1;
+        case IN_UP:
+        case IN_RIGHT:
+        case IN_DOWN:
+        case IN_LEFT:
+        case IN_SHOOT:
+        case IN_TICK:
+                rec->input = rec->type;
+                rec->type = REPLAY_INPUT;
+                return get_dt(r, &rec->dt) < 0 ? -1 : 1;
+        default:
+                return -1;
+        }
+}
+
+void replay_unread(struct replay* r)
+{
+        /* step back before the record just read */
+        r->pos = r->last;
+}
+
+static void tally(game_state* game, unsigned long* won, unsigned long* lost,
+                  unsigned long* left)
+{
+        if (game->status == GAME_WIN)
+                (*won)++;
+        else if (game->status == GAME_LOSE)
+                (*lost)++;
+        else
+                (*left)++;
+}
+
+int replay_run(const char* path, FILE* report)
+{
+        /* play the recording in *path* as fast as possible, with no
+         * terminal, and tell *report* how it went. The result of every
+         * game is checked against the recorded one: the return value is
+         * non zero if any differs or the file can not be read through.
+         */
+        struct replay r;
+        struct replay_rec rec;
+        game_state game;
+        struct timespec t0, t1;
+        unsigned long games = 0, inputs = 0, differ = 0;
+        unsigned long won = 0, lost = 0, left = 0;
+        bool in_game = false;
+        double ms;
+        int n;
+
+        if (replay_open(&r, path) < 0) {
+                perror(path);
+                return 1;
+        }
+        memset(&game, 0, sizeof(game));
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        while ((n = replay_next(&r, &rec)) > 0) {
+                switch (rec.type) {
+                case REPLAY_GAME:
+                        if (in_game)
+                                tally(&game, &won, &lost, &left);
+                        game_init(&game, &rec.conf, rec.height, rec.width);
+                        in_game = true;
+                        games++;
+                        break;
+                case REPLAY_INPUT:
+                        if (in_game) {
+                                game_step(&game, rec.input);
+                                inputs++;
+                        }
+                        break;
+                case REPLAY_END:
+                        if (!in_game)
+                                break;
+                        if (game.status != rec.status ||
+                            game.ammo_left != rec.ammo_left ||
+                            game.target.y != rec.target.y ||
+                            game.target.x != rec.target.x)
+                                differ++;
+                        tally(&game, &won, &lost, &left);
+                        in_game = false;
+                        break;
+                }
+        }
+        if (in_game)
+                tally(&game, &won, &lost, &left);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+
+        fprintf(report, "%lu games: %lu won, %lu lost, %lu unfinished\n",
+                games, won, lost, left);
+        fprintf(report, "%lu inputs in %.3f ms, %.2f M inputs/s\n",
+                inputs, ms, ms > 0 ? inputs / ms / 1e3 : 0.0);
+        if (differ)
+                fprintf(report, "%lu games ended unlike the recording\n",
+                        differ);
+        if (n < 0)
+                fprintf(report, "%s: garbled at byte %zu\n", path, r.last);
+
+        if (games)
+                game_free(&game);
+        replay_close(&r);
+        return (n < 0 || differ) ? 1 : 0;
+}
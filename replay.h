@@ -0,0 +1,81 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Game recordings. A replay file is the magic "MTR1" and then records,
+ * appended as the games go:
+ *
+ *   'G' seed(8) level(1) timer(1) height(2) width(2) name(MAX_PN_LEN)
+ *           a game starts, all that game_init() needs
+ *   1..6 dt  an input fed to game_step(), IN_UP..IN_TICK
+ *   'E' dt status(1) ammo_left(1) target y(2) x(2)
+ *           the game ended as it was left, to check a playback against
+ *
+ * Numbers are little endian, dt is the time in ms since the previous
+ * record of the game as an unsigned LEB128 varint: an input usually takes
+ * two bytes. The writer buffers them, the reader mmap()s the whole file.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+#define REPLAY_MAGIC "MTR1"
+#define REPLAY_BUF 4096
+
+/* record types */
+#define REPLAY_GAME 'G'
+#define REPLAY_END 'E'
+#define REPLAY_INPUT 1  /* stands for all the input values */
+
+struct replay_writer
+{
+        int fd;
+        uint64_t last_ms;       /* time of the previous record */
+        size_t len;
+        unsigned char buf[REPLAY_BUF];
+};
+
+struct replay
+{
+        const unsigned char* data;      /* the mmap()ed file */
+        size_t size;
+        size_t pos;
+        size_t last;                    /* where the last record began */
+};
+
+struct replay_rec
+{
+        int type;
+        unsigned int dt;
+
+        int input;                      /* REPLAY_INPUT */
+
+        game_conf conf;                 /* REPLAY_GAME */
+        int height, width;
+
+        int status, ammo_left;          /* REPLAY_END */
+        point target;
+};
+
+void replay_close(struct replay* r);
+int replay_next(struct replay* r, struct replay_rec* rec);
+int replay_open(struct replay* r, const char* path);
+int replay_run(const char* path, FILE* report);
+void replay_unread(struct replay* r);
+
+void replay_end(struct replay_writer* w, game_state* game, uint64_t now_ms);
+void replay_flush(struct replay_writer* w);
+void replay_game(struct replay_writer* w, game_conf* conf, int height,
+                 int width, uint64_t now_ms);
+void replay_input(struct replay_writer* w, int input, uint64_t now_ms);
+struct replay_writer* replay_writer_open(const char* path);
+void replay_writer_close(struct replay_writer* w);
+
+#endif /* REPLAY_H */
@@ -0,0 +1,77 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * PCG32 random generator, see rng.h. The algorithm is M.E. O'Neill's
+ * pcg32 (XSH RR output on a 64-bit LCG), http://www.pcg-random.org/
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include <time.h>
+#include <unistd.h>
+
+#include "rng.h"
+
+#define PCG_MULT 6364136223846793005ULL
+
+void rng_seed(struct rng* r, uint64_t seed)
+{
+        /* pcg32_srandom(seed, seed): one seed gives both the start and
+         * the stream */
+        r->state = 0;
+        r->inc = (seed << 1) | 1;
+        rng_next(r);
+        r->state += seed;
+        rng_next(r);
+}
+
+uint32_t rng_next(struct rng* r)
+{
+        uint64_t old = r->state;
+        uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+        uint32_t rot = old >> 59;
+
+        r->state = old * PCG_MULT + r->inc;
+        return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+uint64_t rng_next64(struct rng* r)
+{
+        uint64_t hi = rng_next(r);
+
+        return hi << 32 | rng_next(r);
+}
+
+uint32_t rng_below(struct rng* r, uint32_t bound)
+{
+        /* uniform in [0, bound), by Lemire's multiply and reject: no
+         * division unless a draw falls in the biased low part */
+        uint64_t m = (uint64_t)rng_next(r) * bound;
+        uint32_t low = m;
+        uint32_t threshold;
+
+        if (low < bound) {
+                threshold = -bound % bound;
+                while (low < threshold) {
+                        m = (uint64_t)rng_next(r) * bound;
+                        low = m;
+                }
+        }
+        return m >> 32;
+}
+
+uint64_t rng_entropy(void)
+{
+        /* a seed for whoever did not ask for one: the clock and the pid,
+         * mixed by a splitmix64 round */
+        struct timespec ts;
+        uint64_t z;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        z = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        z += (uint64_t)getpid() << 32;
+        z += 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+}
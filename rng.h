@@ -0,0 +1,28 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * A small PCG32 random generator. Every game carries its own, seeded
+ * explicitly: the same seed always gives the same targets, and games on
+ * different threads never share libc's rand() state.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+struct rng
+{
+        uint64_t state;
+        uint64_t inc;           /* stream, always odd */
+};
+
+uint64_t rng_entropy(void);
+uint32_t rng_below(struct rng* r, uint32_t bound);
+uint32_t rng_next(struct rng* r);
+uint64_t rng_next64(struct rng* r);
+void rng_seed(struct rng* r, uint64_t seed);
+
+#endif /* RNG_H */
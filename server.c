@@ -0,0 +1,607 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Multi-session server and its client, see server.h.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#define _GNU_SOURCE     /* accept4(), memfd_create(), fallocate() */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "rng.h"
+#include "stats.h"
+#include "timing.h"
+#include "ui.h"
+
+/* what a connection is woken up by, see struct watch */
+#define WATCH_TERM 0    /* the terminal: the hello, then the keys */
+#define WATCH_TIMER 1   /* the timer of the session */
+#define WATCH_WAKE 2    /* a frame held back is due */
+#define FDS_PER_SESSION 6       /* socket, memfd, their dups, two timers */
+
+/* ---------------------------------------------------------------------------
+ * global vars
+ */
+static volatile sig_atomic_t stop;
+
+/* a connection, from its hello to the hang up. Its session is stepped
+ * whenever one of its descriptors is ready, each registered in the epoll
+ * set with a watch telling which one it is */
+struct conn;
+struct watch
+{
+        struct conn* c;
+        int what;               /* WATCH_* */
+};
+struct conn
+{
+        int fd;                 /* the socket, nonblocking */
+        int out;                /* memfd: what the session wrote for it */
+        off_t sent;             /* of *out*, gone to the socket */
+        bool blocked;           /* the socket is full, EPOLLOUT watched */
+        bool cut;               /* SERVER_OUTBUF behind, hung up on */
+        char term[64];          /* the hello, read so far */
+        size_t len;
+        uint64_t seed;
+        session* s;             /* once started */
+        struct timer wake;      /* when session_step() wants to go on */
+        unsigned long long cpu; /* nanoseconds, spent on the session */
+        struct watch watch[3];
+        bool done;              /* hung up: the events left are stale */
+        struct conn* next;      /* to be freed, see server_run() */
+};
+static int epfd;
+static struct conn* gone;       /* hung up while handling the events */
+static struct rng seeds;        /* of the sessions, in order of arrival */
+static int max_fps;             /* of every session, see ui.h */
+
+/* what the sessions cost */
+static unsigned long sessions, live, peak_live;
+static unsigned long long heap_total, heap_max;
+static unsigned long long cpu_total, cpu_max;   /* nanoseconds */
+static unsigned long dropped;   /* frames, the terminal lagging */
+static unsigned long cut_off;   /* sessions, the terminal not reading */
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+static void accept_conns(int lfd, int max_sessions);
+static void account(session* s, unsigned long long cpu);
+static unsigned long long cpu_ns(void);
+static int flush_out(struct conn* c);
+static void hang_up(struct conn* c);
+static void on_event(struct watch* w, uint32_t events);
+static void on_signal(int sig);
+static void read_hello(struct conn* c);
+static int room_for(int max_sessions);
+static void start(struct conn* c);
+static void step(struct conn* c);
+static void summary(void);
+static void unwatch(int fd);
+static void watch(int fd, struct watch* w, uint32_t events);
+static int write_all(int fd, const char* buf, size_t count);
+/* -------------------------------------------------------------------------- */
+
+int server_run(const char* path, int max_sessions, uint64_t seed, int fps)
+{
+        struct sockaddr_un addr;
+        struct sigaction sa;
+        struct epoll_event ev, events[SERVER_EVENTS];
+        struct conn* c;
+        bool listening = TRUE;
+        int lfd, i, n;
+
+        if (strlen(path) >= sizeof(addr.sun_path)) {
+                fprintf(stderr, "%s: socket path too long\n", path);
+                return 1;
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+
+        lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (lfd < 0) {
+                perror("socket");
+                return 1;
+        }
+        unlink(path);
+        if (bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+            listen(lfd, SOMAXCONN) < 0) {
+                perror(path);
+                close(lfd);
+                return 1;
+        }
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd < 0) {
+                perror("epoll_create1");
+                close(lfd);
+                return 1;
+        }
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;             /* the listening socket */
+        epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev);
+
+        /* a player hanging up must not kill everybody; set before any
+         * newterm() so that ncurses leaves SIGINT and SIGTERM to us */
+        signal(SIGPIPE, SIG_IGN);
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_signal;      /* no SA_RESTART: stop epoll_wait() */
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+
+        rng_seed(&seeds, seed);
+        max_fps = fps;
+        max_sessions = room_for(max_sessions);
+        fprintf(stderr, "listening on %s, up to %d sessions, seed %llu\n",
+                path, max_sessions, (unsigned long long)seed);
+        while (!stop) {
+                n = epoll_wait(epfd, events, SERVER_EVENTS, -1);
+                if (n < 0) {
+                        if (errno != EINTR)
+                                perror("epoll_wait");
+                        continue;
+                }
+                for (i=0; i<n; i++) {
+                        if (events[i].data.ptr == NULL)
+                                accept_conns(lfd, max_sessions);
+                        else
+                                on_event(events[i].data.ptr,
+                                         events[i].events);
+                }
+
+                /* nothing points at them any more */
+                while (gone != NULL) {
+                        c = gone;
+                        gone = c->next;
+                        free(c);
+                }
+
+                /* the new connections wait in the backlog while the
+                 * sessions are all taken */
+                if (listening != (live < (unsigned long)max_sessions)) {
+                        listening = !listening;
+                        epoll_ctl(epfd, listening ? EPOLL_CTL_ADD :
+                                  EPOLL_CTL_DEL, lfd, &ev);
+                }
+        }
+
+        close(lfd);
+        unlink(path);
+        summary();
+        stats_dump(stderr);
+        return 0;
+}
+
+static void on_signal(int sig)
+{
+        stop = 1;
+}
+
+static int room_for(int max_sessions)
+{
+        /* raise the limit of the open descriptors as far as allowed, and
+         * take *max_sessions* down to what fits in */
+        struct rlimit rl;
+        rlim_t need = (rlim_t)max_sessions * FDS_PER_SESSION + 16;
+
+        if (getrlimit(RLIMIT_NOFILE, &rl) < 0)
+                return max_sessions;
+        if (rl.rlim_cur < need && rl.rlim_cur < rl.rlim_max) {
+                rl.rlim_cur = rl.rlim_max < need ? rl.rlim_max : need;
+                setrlimit(RLIMIT_NOFILE, &rl);
+                getrlimit(RLIMIT_NOFILE, &rl);
+        }
+        if (rl.rlim_cur < need) {
+                fprintf(stderr, "%d sessions need %llu descriptors, the "
+                        "limit is %llu\n", max_sessions,
+                        (unsigned long long)need,
+                        (unsigned long long)rl.rlim_cur);
+                max_sessions = rl.rlim_cur > 16 + FDS_PER_SESSION ?
+                        (rl.rlim_cur - 16) / FDS_PER_SESSION : 1;
+        }
+        return max_sessions;
+}
+
+static void watch(int fd, struct watch* w, uint32_t events)
+{
+        struct epoll_event ev;
+
+        if (fd < 0)
+                return;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.ptr = w;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void unwatch(int fd)
+{
+        if (fd >= 0)
+                epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+static unsigned long long cpu_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void accept_conns(int lfd, int max_sessions)
+{
+        /* take the connections waiting, while there is room: each then
+         * sends its hello */
+        struct conn* c;
+        int fd, i;
+
+        while (live < (unsigned long)max_sessions) {
+                fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK &&
+                            errno != EINTR)
+                                perror("accept");
+                        return;
+                }
+                c = calloc(1, sizeof(struct conn));
+                if (c == NULL) {
+                        fputs("Memory error.", stderr);
+                        exit(1);
+                }
+                c->fd = fd;
+                c->out = -1;
+                c->seed = rng_next64(&seeds);
+                c->wake.fd = -1;
+                for (i=0; i<3; i++) {
+                        c->watch[i].c = c;
+                        c->watch[i].what = i;
+                }
+                if (++live > peak_live)
+                        peak_live = live;
+                watch(fd, &c->watch[WATCH_TERM], EPOLLIN | EPOLLRDHUP);
+        }
+}
+
+static void on_event(struct watch* w, uint32_t events)
+{
+        struct conn* c = w->c;
+
+        if (c->done)
+                return;
+        if (c->s == NULL) {
+                read_hello(c);
+                return;
+        }
+        if (events & EPOLLOUT) {
+                if (flush_out(c) < 0) {
+                        hang_up(c);
+                        return;
+                }
+                if (!(events & ~EPOLLOUT))
+                        return;
+        }
+        if (w->what == WATCH_WAKE)
+                timer_expired(&c->wake);
+        if (w->what == WATCH_TERM &&
+            (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+                c->s->closed = TRUE;
+        step(c);
+}
+
+static void read_hello(struct conn* c)
+{
+        /* the first line is the TERM of the client, byte by byte so that
+         * no key is read ahead of the session, which starts once the line
+         * is all there */
+        ssize_t n;
+        char ch;
+
+        while ((n = recv(c->fd, &ch, 1, MSG_DONTWAIT)) == 1) {
+                if (ch == '\n') {
+                        c->term[c->len] = '\0';
+                        if (c->len)
+                                start(c);
+                        else
+                                hang_up(c);
+                        return;
+                }
+                if (c->len == sizeof(c->term) - 1) {
+                        hang_up(c);
+                        return;
+                }
+                c->term[c->len++] = ch;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK &&
+                       errno != EINTR))
+                hang_up(c);
+}
+
+static void start(struct conn* c)
+{
+        /* greet the player on the connection *c*. The screen of the
+         * session talks through descriptors of its own (see ui.c): it
+         * reads the socket, and writes to a memfd, which never blocks, to
+         * be sent from there by flush_out() */
+        unsigned long long t0 = cpu_ns();
+        session* s = calloc(1, sizeof(session));
+        FILE* in = NULL;
+        FILE* out = NULL;
+        int fd, started = -1;
+
+        if (s != NULL) {
+                s->seed = c->seed;
+                s->max_fps = max_fps;
+                s->raw_keys = TRUE;     /* wgetch() would wait on an ESC */
+        }
+        c->out = memfd_create("mtarget", MFD_CLOEXEC);
+        if (c->out >= 0 && (fd = dup(c->fd)) >= 0 &&
+            (in = fdopen(fd, "r")) == NULL)
+                close(fd);
+        if (in != NULL && (fd = dup(c->out)) >= 0 &&
+            (out = fdopen(fd, "w")) == NULL)
+                close(fd);
+        if (s != NULL && out != NULL && timer_open(&c->wake) == 0)
+                started = session_start(s, c->term, out, in);
+
+        if (out != NULL)
+                fclose(out);
+        if (in != NULL)
+                fclose(in);
+        c->cpu += cpu_ns() - t0;
+        if (started < 0) {
+                free(s);
+                hang_up(c);
+                return;
+        }
+
+        /* the frames are held back on what the socket has queued */
+        link_open(&s->link, c->fd);
+        c->s = s;
+        watch(s->timer.fd, &c->watch[WATCH_TIMER], EPOLLIN);
+        watch(c->wake.fd, &c->watch[WATCH_WAKE], EPOLLIN);
+        if (flush_out(c) < 0)
+                hang_up(c);
+}
+
+static void step(struct conn* c)
+{
+        /* go on with the session of *c*, and wake it up again when it
+         * asks to */
+        unsigned long long t0 = cpu_ns();
+        int delay = session_step(c->s);
+
+        c->cpu += cpu_ns() - t0;
+        if (delay == SESSION_OVER) {
+                hang_up(c);
+                return;
+        }
+        if (delay >= 0)
+                timer_after(&c->wake, delay * 1000ULL);
+        if (flush_out(c) < 0)
+                hang_up(c);
+}
+
+static int flush_out(struct conn* c)
+{
+        /* send what the session wrote since, as much of it as the socket
+         * takes now: the rest waits in c->out, and EPOLLOUT is watched
+         * until it has gone. -1 if the player hung up, or lets more than
+         * SERVER_OUTBUF wait: one who stops reading must not hold up the
+         * others */
+        off_t end = lseek(c->out, 0, SEEK_CUR);
+        struct epoll_event ev;
+        ssize_t n;
+
+        while (c->sent < end) {
+                n = sendfile(c->fd, c->out, &c->sent, end - c->sent);
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                        break;
+                if (n <= 0)
+                        return -1;
+        }
+
+        if (c->sent == end) {
+                /* all gone: the next output starts over, on a file cut
+                 * back if a lagging terminal had it grow */
+                if (end > 0)
+                        lseek(c->out, 0, SEEK_SET);
+                if (end > SERVER_OUTBUF)
+                        ftruncate(c->out, 0);
+                c->sent = 0;
+        }
+        else if (end - c->sent > SERVER_OUTBUF) {
+                c->cut = TRUE;
+                return -1;
+        }
+        else if (c->sent >= SERVER_OUTBUF) {
+                /* what has gone takes no memory any more */
+                fallocate(c->out, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                          0, c->sent);
+        }
+
+        if (c->blocked != (c->sent < end)) {
+                c->blocked = !c->blocked;
+                memset(&ev, 0, sizeof(ev));
+                ev.events = EPOLLIN | EPOLLRDHUP |
+                        (c->blocked ? EPOLLOUT : 0);
+                ev.data.ptr = &c->watch[WATCH_TERM];
+                epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        }
+        return 0;
+}
+
+static void hang_up(struct conn* c)
+{
+        /* the connection is over: its session, if it started, let go and
+         * accounted. *c* is freed after the events at hand */
+        unsigned long long t0;
+
+        if (c->s != NULL) {
+                unwatch(c->s->timer.fd);
+                unwatch(c->wake.fd);
+                t0 = cpu_ns();
+                session_end(c->s);
+                c->cpu += cpu_ns() - t0;
+                account(c->s, c->cpu);
+                free(c->s);
+                if (!c->cut)
+                        flush_out(c);   /* the goodbye, if it fits */
+        }
+        cut_off += c->cut;
+        unwatch(c->fd);
+        close(c->fd);
+        if (c->out >= 0)
+                close(c->out);
+        timer_close(&c->wake);
+        live--;
+        c->done = TRUE;
+        c->next = gone;
+        gone = c;
+}
+
+static void account(session* s, unsigned long long cpu)
+{
+        sessions++;
+        heap_total += s->heap_bytes;
+        if (s->heap_bytes > heap_max)
+                heap_max = s->heap_bytes;
+        cpu_total += cpu;
+        if (cpu > cpu_max)
+                cpu_max = cpu;
+        dropped += s->link.dropped;
+
+        fprintf(stderr, "session %lu: seed %llu, %zu B heap, %.3f ms cpu, "
+                "%lu frames dropped\n", sessions, (unsigned long long)s->seed,
+                s->heap_bytes, cpu / 1e6, s->link.dropped);
+}
+
+static void summary(void)
+{
+        fprintf(stderr, "%lu sessions, %lu at most at once, %lu still "
+                "playing\n", sessions, peak_live, live);
+        if (sessions)
+                fprintf(stderr, "per session: heap %llu B avg, %llu B max; "
+                        "cpu %.3f ms avg, %.3f ms max\n",
+                        heap_total / sessions, heap_max,
+                        cpu_total / 1e6 / sessions, cpu_max / 1e6);
+        if (dropped)
+                fprintf(stderr, "%lu frames dropped, the terminals lagging\n",
+                        dropped);
+        if (cut_off)
+                fprintf(stderr, "%lu sessions cut off, their terminals not "
+                        "reading\n", cut_off);
+}
+
+int client_run(const char* path)
+{
+        /* relay this terminal to the server at *path* until it hangs up */
+        struct sockaddr_un addr;
+        struct termios saved, raw;
+        struct pollfd fds[2];
+        const char* term = getenv("TERM");
+        bool tty = isatty(STDIN_FILENO);
+        char buf[4096];
+        ssize_t n;
+        int fd;
+
+        if (strlen(path) >= sizeof(addr.sun_path)) {
+                fprintf(stderr, "%s: socket path too long\n", path);
+                return 1;
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+                perror(path);
+                return 1;
+        }
+        if (term == NULL)
+                term = "vt100";
+        if (write_all(fd, term, strlen(term)) < 0 ||
+            write_all(fd, "\n", 1) < 0) {
+                perror(path);
+                close(fd);
+                return 1;
+        }
+
+        /* the keys go as they are typed, the server does the rest */
+        if (tty) {
+                tcgetattr(STDIN_FILENO, &saved);
+                raw = saved;
+                cfmakeraw(&raw);
+                tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        }
+
+        fds[0].fd = STDIN_FILENO;
+        fds[0].events = POLLIN;
+        fds[1].fd = fd;
+        fds[1].events = POLLIN;
+        while (TRUE) {
+                if (poll(fds, 2, -1) < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        break;
+                }
+                if (fds[1].revents) {
+                        n = read(fd, buf, sizeof(buf));
+                        if (n <= 0 || write_all(STDOUT_FILENO, buf, n) < 0)
+                                break;
+                }
+                if (fds[0].revents) {
+                        n = read(STDIN_FILENO, buf, sizeof(buf));
+                        if (n <= 0) {
+                                /* no more keys: let the server close */
+                                shutdown(fd, SHUT_WR);
+                                fds[0].fd = -1;
+                        }
+                        else if (write_all(fd, buf, n) < 0) {
+                                break;
+                        }
+                }
+        }
+
+        if (tty)
+                tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+        close(fd);
+        return 0;
+}
+
+static int write_all(int fd, const char* buf, size_t count)
+{
+        ssize_t n;
+
+        while (count) {
+                n = write(fd, buf, count);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return -1;
+                }
+                buf += n;
+                count -= n;
+        }
+        return 0;
+}
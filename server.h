@@ -0,0 +1,34 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Many players in one process: the server listens on a Unix socket and
+ * plays a session (see ui.h) for every connection. A single thread drives
+ * them all from one epoll set: whenever a terminal has keys, or a timer of
+ * a session goes off, its session takes one step and the thread goes on
+ * with the next one, so that a session costs its memory and a few
+ * descriptors but no thread. Each connection gets its session seed, in
+ * order of arrival, off the server seed. The client relays a terminal to
+ * the server: it sends the TERM name on the first line, then the raw keys
+ * one way and the screen the other way.
+ *
+ * Nothing waits on a client: the sockets are nonblocking, and what a
+ * session draws goes to a memfd of its own, sent on from there as the
+ * socket takes it. A client which lets more than SERVER_OUTBUF of it pile
+ * up, having stopped reading, is hung up on.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+
+#define SERVER_SESSIONS 1024    /* default max sessions played at once */
+#define SERVER_EVENTS 256       /* handled per epoll_wait() */
+#define SERVER_OUTBUF 65536     /* bytes waiting for a client, at most */
+
+int client_run(const char* path);
+int server_run(const char* path, int max_sessions, uint64_t seed, int fps);
+
+#endif /* SERVER_H */
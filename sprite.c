@@ -0,0 +1,77 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Sprites, see sprite.h.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include "sprite.h"
+#include "render.h"
+
+#define CLEAR 0         /* see through */
+
+/*            _ _
+ *           / _ \
+ *          | (_) |
+ *           \_ _/
+ */
+static const chtype target_cells[] = {
+        CLEAR, CLEAR, '_', CLEAR, '_', CLEAR, CLEAR,
+        CLEAR, '/', CLEAR, '_', CLEAR, '\\', CLEAR,
+        '|', CLEAR, '(', '_', ')', CLEAR, '|',
+        CLEAR, '\\', '_', CLEAR, '_', '/', CLEAR,
+};
+
+/*            |
+ *          -   -
+ *            |
+ */
+static const chtype gunsight_cells[] = {
+        CLEAR, CLEAR, '|', CLEAR, CLEAR,
+        LINE_HLINE, CLEAR, CLEAR, CLEAR, LINE_HLINE,
+        CLEAR, CLEAR, '|', CLEAR, CLEAR,
+};
+
+/*            _____
+ *           /     \
+ *          /   ab  \
+ *          \  ab   /
+ *           \_____/
+ *
+ * a light of the lamp, its face *a* *b* on the two middle rows: the rest
+ * of the inside is left alone, as nothing else is ever there */
+#define LIGHT(a, b)                                                     \
+        CLEAR, CLEAR, '_', '_', '_', '_', '_', CLEAR, CLEAR,            \
+        CLEAR, '/', CLEAR, CLEAR, CLEAR, CLEAR, CLEAR, '\\', CLEAR,     \
+        '/', CLEAR, CLEAR, ' ', a, b, CLEAR, CLEAR, '\\',               \
+        '\\', CLEAR, ' ', a, b, CLEAR, CLEAR, CLEAR, '/',               \
+        CLEAR, '\\', '_', '_', '_', '_', '_', '/', CLEAR
+
+static const chtype light_cells[4][5 * 9] = {
+        {LIGHT(':', '(')},
+        {LIGHT(':', '/')},
+        {LIGHT(':', ')')},
+        {LIGHT(' ', ' ')},
+};
+
+const struct sprite sprite_target = {4, 7, 2, 3, target_cells};
+const struct sprite sprite_gunsight = {3, 5, 1, 2, gunsight_cells};
+const struct sprite sprite_light[3] = {
+        {5, 9, 0, 0, light_cells[0]},
+        {5, 9, 0, 0, light_cells[1]},
+        {5, 9, 0, 0, light_cells[2]},
+};
+const struct sprite sprite_light_off = {5, 9, 0, 0, light_cells[3]};
+
+chtype sprite_cell(const struct sprite* sp, int dy, int dx)
+{
+        /* the cell *dy*, *dx* away from where *sp* is put, 0 if there is
+         * none or it is transparent */
+        int y = sp->cy + dy;
+        int x = sp->cx + dx;
+
+        if (y < 0 || x < 0 || y >= sp->height || x >= sp->width)
+                return CLEAR;
+        return sp->cells[y * sp->width + x];
+}
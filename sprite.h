@@ -0,0 +1,44 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Sprites: the shapes of the game screens, the target, the gunsight and
+ * the lights of the lamp, as constant tables of cells. A cell 0 is
+ * transparent, leaving what is under it; the others are drawn in the
+ * color the sprite is blitted with, a run of them side by side with a
+ * single write (see blit() in ui.c).
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef SPRITE_H
+#define SPRITE_H
+
+#include <ncurses.h>
+
+/* ---------------------------------------------------------------------------
+ * data structures definition
+ */
+struct sprite
+{
+        int height, width;
+        int cy, cx;             /* the cell which goes at the point given */
+        const chtype* cells;    /* *height* rows of *width* */
+};
+
+/* the target, centered on its bottom '_' */
+extern const struct sprite sprite_target;
+
+/* the gunsight, centered on the cell aimed at, which it leaves alone */
+extern const struct sprite sprite_gunsight;
+
+/* the lights of the lamp from the top, lit, then one turned off; all
+ * from their top left corner */
+extern const struct sprite sprite_light[3];
+extern const struct sprite sprite_light_off;
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+chtype sprite_cell(const struct sprite* sp, int dy, int dx);
+
+#endif /* SPRITE_H */
@@ -0,0 +1,187 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Terminal output and hot path accounting, see stats.h.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include "stats.h"
+
+#ifdef MT_STATS
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+struct out_stats out_stats;
+struct ui_stats ui_stats;
+
+static unsigned long start_writes;      /* counters at the frame start */
+static unsigned long start_bytes;
+
+static struct timespec key_time;        /* of the key not yet on screen */
+static unsigned long key_flushes;       /* ui_stats.flushes at that time */
+static bool key_pending;
+static volatile sig_atomic_t dump_requested;
+
+/* glibc's own allocator, under the one counted here */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size)
+{
+        __atomic_add_fetch(&ui_stats.mallocs, 1, __ATOMIC_RELAXED);
+        return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size)
+{
+        __atomic_add_fetch(&ui_stats.mallocs, 1, __ATOMIC_RELAXED);
+        return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+        __atomic_add_fetch(&ui_stats.mallocs, 1, __ATOMIC_RELAXED);
+        return __libc_realloc(ptr, size);
+}
+
+static void on_usr1(int sig)
+{
+        dump_requested = 1;
+}
+
+void stats_init()
+{
+        /* SIGUSR1 asks for a dump, on stderr at the next frame */
+        struct sigaction sa;
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_usr1;
+        sa.sa_flags = SA_RESTART;
+        sigaction(SIGUSR1, &sa, NULL);
+}
+
+void stats_key()
+{
+        /* a key arrived: the frame showing it closes its latency */
+        if (!key_pending) {
+                clock_gettime(CLOCK_MONOTONIC, &key_time);
+                key_flushes = ui_stats.flushes;
+                key_pending = true;
+        }
+}
+
+static void key_shown(void)
+{
+        struct timespec now;
+        unsigned long us;
+        int bucket = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        us = (now.tv_sec - key_time.tv_sec) * 1000000 +
+                (now.tv_nsec - key_time.tv_nsec) / 1000;
+        while (us && bucket < LATENCY_BUCKETS-1) {
+                us >>= 1;
+                bucket++;
+        }
+        ui_stats.latency[bucket]++;
+        ui_stats.keys++;
+        key_pending = false;
+}
+
+static void written(unsigned long* writes, unsigned long* bytes)
+{
+        /* the write(2) calls and bytes of the calling thread so far: its
+         * io file is opened the first time and pread() from then on */
+        static __thread int io_fd = -1;
+        char buf[256];
+        char* p;
+        ssize_t n = -1;
+
+        if (io_fd < 0)
+                io_fd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+        if (io_fd >= 0)
+                n = pread(io_fd, buf, sizeof(buf)-1, 0);
+        buf[n > 0 ? n : 0] = '\0';
+        *writes = (p = strstr(buf, "syscw: ")) ? strtoul(p + 7, NULL, 10) : 0;
+        *bytes = (p = strstr(buf, "wchar: ")) ? strtoul(p + 7, NULL, 10) : 0;
+}
+
+void stats_frame_begin()
+{
+        written(&start_writes, &start_bytes);
+}
+
+void stats_frame_end()
+{
+        /* account what was written since stats_frame_begin() as a frame,
+         * unless nothing was, and the key it shows if any */
+        unsigned long writes, bytes;
+
+        written(&writes, &bytes);
+        writes -= start_writes;
+        bytes -= start_bytes;
+        out_stats.writes += writes;
+        out_stats.bytes += bytes;
+        if (writes) {
+                out_stats.frames++;
+                out_stats.frame_writes += writes;
+                out_stats.frame_bytes += bytes;
+                if (writes > out_stats.max_frame_writes)
+                        out_stats.max_frame_writes = writes;
+                if (bytes > out_stats.max_frame_bytes)
+                        out_stats.max_frame_bytes = bytes;
+        }
+        if (key_pending && ui_stats.flushes != key_flushes)
+                key_shown();
+        stats_frame_begin();
+
+        if (dump_requested) {
+                dump_requested = 0;
+                stats_dump(stderr);
+        }
+}
+
+void stats_dump(FILE* f)
+{
+        struct out_stats* s = &out_stats;
+        struct ui_stats* u = &ui_stats;
+        unsigned long frames = s->frames ? s->frames : 1;
+        unsigned long flushes = u->flushes ? u->flushes : 1;
+        unsigned long sum = 0;
+        int i, last;
+
+        fprintf(f, "write calls: %lu, bytes: %lu\n", s->writes, s->bytes);
+        fprintf(f, "frames: %lu\n", s->frames);
+        fprintf(f, "write calls per frame: %.2f, max %lu\n",
+                (double)s->frame_writes / frames, s->max_frame_writes);
+        fprintf(f, "bytes per frame: %.1f, max %lu\n",
+                (double)s->frame_bytes / frames, s->max_frame_bytes);
+
+        fprintf(f, "flushes: %lu, windows marked: %lu, blanked: %lu\n",
+                u->flushes, u->marks, u->blanks);
+        fprintf(f, "cells drawn: %lu, %.1f per flush\n", u->cells,
+                (double)u->cells / flushes);
+        fprintf(f, "frames dropped, the terminal lagging: %lu\n",
+                u->dropped);
+        fprintf(f, "heap allocations: %lu\n", u->mallocs);
+
+        /* the latency histogram, up to the slowest bucket */
+        for (last=LATENCY_BUCKETS-1; last>0 && !u->latency[last]; last--)
+                ;
+        fprintf(f, "key to screen latency, %lu keys:\n", u->keys);
+        for (i=0; u->keys && i<=last; i++) {
+                sum += u->latency[i];
+                fprintf(f, "  < %8lu us: %8lu  %5.1f%%\n", 1UL << i,
+                        u->latency[i], 100.0 * sum / u->keys);
+        }
+}
+
+#endif /* MT_STATS */
@@ -0,0 +1,74 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Terminal output accounting: how many write(2) calls and bytes every frame
+ * costs, as the kernel counts them for the thread drawing it (see
+ * /proc/thread-self/io in proc(5)). Along with it the hot path counters of the
+ * front-end (windows marked and blanked, cells drawn, heap allocations)
+ * and how long a key takes to reach the screen, as a histogram.
+ *
+ * Compiled in with `make STATS=1', otherwise it all compiles away. The
+ * figures are dumped on exit, and on SIGUSR1 at the next frame. They are
+ * the process's: with --server every session adds to the same ones, and
+ * the writes of a frame are those of the thread stepping them all.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#ifdef MT_STATS
+
+struct out_stats
+{
+        unsigned long writes;           /* all of them, while playing */
+        unsigned long bytes;
+        unsigned long frames;           /* frames which wrote something */
+        unsigned long frame_writes;     /* the part written by frames */
+        unsigned long frame_bytes;
+        unsigned long max_frame_writes;
+        unsigned long max_frame_bytes;
+};
+
+/* key to screen latency, by powers of two of microseconds */
+#define LATENCY_BUCKETS 24
+
+struct ui_stats
+{
+        unsigned long marks;            /* windows taken into a frame */
+        unsigned long blanks;           /* windows erased */
+        unsigned long cells;            /* characters drawn */
+        unsigned long flushes;          /* frames sent to the backend */
+        unsigned long dropped;          /* frames held back, never sent */
+        unsigned long mallocs;          /* by anybody, malloc() and co. */
+        unsigned long keys;             /* timed in latency[] */
+        unsigned long latency[LATENCY_BUCKETS];
+};
+
+extern struct out_stats out_stats;
+extern struct ui_stats ui_stats;
+
+#define stats_add(counter, n) (ui_stats.counter += (n))
+
+void stats_dump(FILE* f);
+void stats_frame_begin(void);
+void stats_frame_end(void);
+void stats_init(void);
+void stats_key(void);
+
+#else
+
+#define stats_add(counter, n) do { } while (0)
+#define stats_dump(f) do { } while (0)
+#define stats_frame_begin() do { } while (0)
+#define stats_frame_end() do { } while (0)
+#define stats_init() do { } while (0)
+#define stats_key() do { } while (0)
+
+#endif /* MT_STATS */
+
+#endif /* STATS_H */
@@ -0,0 +1,225 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Timers and pacers, see timing.h.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <linux/sockios.h>
+
+#include "timing.h"
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+static void arm(struct timer* t, uint64_t at, uint64_t interval);
+static struct timespec to_timespec(uint64_t us);
+/* -------------------------------------------------------------------------- */
+
+uint64_t mono_us(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+uint64_t mono_ms(void)
+{
+        return mono_us() / 1000;
+}
+
+static struct timespec to_timespec(uint64_t us)
+{
+        struct timespec ts;
+
+        ts.tv_sec = us / 1000000;
+        ts.tv_nsec = us % 1000000 * 1000;
+        return ts;
+}
+
+/* ---------------------------------------------------------------------------
+ * timers
+ */
+int timer_open(struct timer* t)
+{
+        /* a stopped timer; -1 if the system has none to give */
+        memset(t, 0, sizeof(struct timer));
+        t->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        return t->fd < 0 ? -1 : 0;
+}
+
+void timer_close(struct timer* t)
+{
+        if (t->fd >= 0)
+                close(t->fd);
+        t->fd = -1;
+}
+
+static void arm(struct timer* t, uint64_t at, uint64_t interval)
+{
+        /* go off at the absolute time *at*, then every *interval* if not
+         * 0; both 0 disarms */
+        struct itimerspec its;
+
+        its.it_value = to_timespec(at);
+        its.it_interval = to_timespec(interval);
+        timerfd_settime(t->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+void timer_start_ticks(struct timer* t)
+{
+        /* tick every second, from a second from now */
+        t->ticking = true;
+        t->paused = false;
+        t->next = mono_us() + TICK_US;
+        arm(t, t->next, TICK_US);
+}
+
+void timer_after(struct timer* t, uint64_t us)
+{
+        /* go off once, *us* from now */
+        t->ticking = false;
+        t->paused = false;
+        t->next = mono_us() + us;
+        arm(t, t->next, 0);
+}
+
+void timer_stop(struct timer* t)
+{
+        t->paused = false;
+        arm(t, 0, 0);
+}
+
+void timer_pause(struct timer* t)
+{
+        /* stop, keeping the time to the next tick */
+        uint64_t now = mono_us();
+
+        if (t->paused)
+                return;
+        t->left = t->next > now ? t->next - now : 0;
+        t->paused = true;
+        arm(t, 0, 0);
+}
+
+void timer_resume(struct timer* t)
+{
+        /* go on as if the pause had never been */
+        if (!t->paused)
+                return;
+        t->paused = false;
+        t->next = mono_us() + t->left;
+        arm(t, t->next, t->ticking ? TICK_US : 0);
+}
+
+uint64_t timer_expired(struct timer* t)
+{
+        /* how many times it went off since the last call, 0 if none */
+        uint64_t n;
+
+        if (read(t->fd, &n, sizeof(n)) != sizeof(n))
+                return 0;
+        if (t->ticking)
+                t->next += n * TICK_US;
+        return n;
+}
+
+/* ---------------------------------------------------------------------------
+ * pacers
+ */
+void pacer_init(struct pacer* p, int fps)
+{
+        /* at most *fps* frames a second, as many as asked for if 0 */
+        p->interval = fps > 0 ? 1000000 / fps : 0;
+        p->last = 0;
+}
+
+int pacer_delay_ms(struct pacer* p, uint64_t now)
+{
+        /* 0 if a frame can go at *now*, else the milliseconds to wait,
+         * rounded up */
+        uint64_t due = p->last + p->interval;
+
+        if (p->interval == 0 || now >= due)
+                return 0;
+        return (due - now + 999) / 1000;
+}
+
+void pacer_mark(struct pacer* p, uint64_t now)
+{
+        /* a frame went at *now* */
+        p->last = now;
+}
+
+/* ---------------------------------------------------------------------------
+ * links
+ */
+void link_open(struct link* l, int fd)
+{
+        /* the frames go to *fd*: how many of its bytes are still queued
+         * is asked with TIOCOUTQ if a tty, SIOCOUTQ if a socket */
+        struct stat st;
+
+        l->fd = fd;
+        l->outq = 0;
+        if (fstat(fd, &st) == 0 && S_ISSOCK(st.st_mode))
+                l->outq = SIOCOUTQ;
+        else if (isatty(fd))
+                l->outq = TIOCOUTQ;
+}
+
+bool link_probe(struct link* l, uint64_t now)
+{
+        /* whether a probe goes after the frame just sent, at *now*: not
+         * if one is out already, or no more than one every LINK_LAG_US */
+        if (l->probing || (!l->answers && l->lost >= LINK_TRIES) ||
+            (l->probe_at && now - l->probe_at < LINK_LAG_US))
+                return false;
+        l->probing = true;
+        l->probe_at = now;
+        return true;
+}
+
+void link_answer(struct link* l, uint64_t now)
+{
+        /* the terminal drew everything up to the last probe */
+        if (!l->probing)
+                return;
+        l->probing = false;
+        l->answers = true;
+        l->drain = now - l->probe_at;
+}
+
+int link_delay_ms(struct link* l, uint64_t now)
+{
+        /* 0 if a frame can go at *now*, else the milliseconds after which
+         * to ask again: a full queue every LINK_QUEUE_MS, while the answer
+         * to a probe wakes up who waits for keys */
+        uint64_t age = now - l->probe_at;
+
+        if (l->outq && ioctl(l->fd, l->outq, &l->queued) < 0)
+                l->outq = 0;
+        if (l->outq && l->queued > 0) {
+                l->held = true;
+                return LINK_QUEUE_MS;
+        }
+        if (l->probing && age >= LINK_LOST_US) {
+                l->probing = false;
+                if (!l->answers)
+                        l->lost++;
+        }
+        if (!l->probing || !l->answers || age < LINK_LAG_US) {
+                l->held = false;
+                return 0;
+        }
+        l->held = true;
+        return (LINK_LOST_US - age + 999) / 1000;
+}
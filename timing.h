@@ -0,0 +1,92 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * Time, all of it off CLOCK_MONOTONIC, in microseconds unless told.
+ *
+ *  - a timer: a timerfd to sleep on in poll(), going off every second
+ *    (the game countdown) or once after some time (a recording played
+ *    back). The ticks fall on whole seconds from the moment it started,
+ *    however late they are read, and a pause keeps the time to the next
+ *    tick to the microsecond;
+ *  - a pacer: at most so many frames per second, telling how long to hold
+ *    back a frame which would come too early;
+ *  - a link: how far behind the terminal is, off probes sent after the
+ *    frames which it answers once it has drawn them. A probe unanswered
+ *    after LINK_LAG_US means that the frames pile up on the way (a slow
+ *    ssh session): the next ones are held back until it is answered, so
+ *    that only the latest state goes. A terminal which never answered is
+ *    not held back, and after LINK_TRIES probes is not asked any more.
+ *    Before that, the bytes still queued on the terminal (TIOCOUTQ on a
+ *    tty, SIOCOUTQ on a socket) hold the frames back too: they tell how
+ *    much the first hop did not take yet, the probe how long the rest of
+ *    the way took (a pty has no queue of its own, ssh's is out of sight).
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TICK_US 1000000ULL      /* of the countdown */
+#define LINK_LAG_US 50000ULL    /* a probe out longer: the link is behind */
+#define LINK_LOST_US 2000000ULL /* a probe out longer is given up */
+#define LINK_TRIES 3
+#define LINK_QUEUE_MS 5         /* how often a queue is asked while full */
+
+/* ---------------------------------------------------------------------------
+ * data structures definition
+ */
+struct timer
+{
+        int fd;                 /* -1 when there is none */
+        bool ticking;           /* every second, else once */
+        bool paused;
+        uint64_t next;          /* when it goes off next, if running */
+        uint64_t left;          /* to the next time, when paused */
+};
+
+struct pacer
+{
+        uint64_t interval;      /* between two frames, 0 for no cap */
+        uint64_t last;          /* when the last frame went */
+};
+
+struct link
+{
+        int fd;                 /* the terminal, see link_open() */
+        unsigned long outq;     /* the ioctl of its queue, 0 if none */
+        int queued;             /* bytes in that, the last time asked */
+        bool answers;           /* the terminal answered a probe */
+        int lost;               /* probes given up, while it never did */
+        bool probing;           /* a probe is on its way */
+        uint64_t probe_at;      /* when the last one went */
+        uint64_t drain;         /* how long the last answer took */
+        bool held;              /* a frame is held back */
+        unsigned long dropped;  /* frames which never went, see ui.c */
+};
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+void link_answer(struct link* l, uint64_t now);
+int link_delay_ms(struct link* l, uint64_t now);
+void link_open(struct link* l, int fd);
+bool link_probe(struct link* l, uint64_t now);
+uint64_t mono_ms(void);
+uint64_t mono_us(void);
+int pacer_delay_ms(struct pacer* p, uint64_t now);
+void pacer_init(struct pacer* p, int fps);
+void pacer_mark(struct pacer* p, uint64_t now);
+void timer_after(struct timer* t, uint64_t us);
+void timer_close(struct timer* t);
+uint64_t timer_expired(struct timer* t);
+int timer_open(struct timer* t);
+void timer_pause(struct timer* t);
+void timer_resume(struct timer* t);
+void timer_start_ticks(struct timer* t);
+void timer_stop(struct timer* t);
+
+#endif /* TIMING_H */
@@ -0,0 +1,1774 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * The ncurses front-end, see ui.h.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#define _GNU_SOURCE     /* POLLRDHUP */
+
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <ncurses.h> /* may also autoinclude tremios.h or tremio.h or sftty.h */
+
+#include "engine.h"
+#include "hints.h"
+#include "keys.h"
+#include "ui.h"
+#include "replay.h"
+#include "render.h"
+#include "sprite.h"
+#include "stats.h"
+#include "timing.h"
+
+#define mtLINES 24   /* workspace defined as 24 lines x 80 cols*/
+#define mtCOLS 80
+#define LEFT 1
+#define CENTER 2
+#define RIGHT 3
+
+#define KEYS_PER_FRAME 32       /* at most, see session_step() */
+#define SPARE_WINS 8            /* kept by a screen, see keep_win() */
+
+/* the options of ask_options(), one every other line */
+#define OPTION_Y(i) (5 + 2 * (i))
+#define OPTION_X 24
+#define PN_DEFAULT "Daporlaor"
+
+/* the gunsight keeps this far from the edges of the view, see
+ * follow_view() */
+#define VIEW_MARGIN_Y 3
+#define VIEW_MARGIN_X 8
+
+#define EXIT_GAME 0
+#define NEW_GAME 1
+
+/* how a level is shown: practice is 'A', for allenamento */
+#define LEVEL_CH(level) ((level) == LEVEL_PRACTICE ? 'A' : '0' + (level))
+
+#define NO_COLOR 0
+#define RED_ON_BLACK 1
+#define GREEN_ON_BLACK 2
+#define YELLOW_ON_BLACK 3
+#define BLUE_ON_BLACK 4
+#define MAGENTA_ON_BLACK 5
+#define CYAN_ON_BLACK 6
+#define WHITE_ON_BLACK 7
+#define BLACK_ON_RED 8
+#define BLACK_ON_GREEN 9
+#define BLACK_ON_YELLOW 10
+#define BLACK_ON_BLUE 11
+#define BLACK_ON_MAGENTA 12
+#define BLACK_ON_CYAN 13
+#define BLACK_ON_WHITE 14
+
+/* ---------------------------------------------------------------------------
+ * global vars
+ */
+/* ncurses keeps its state in globals: whoever touches it holds this lock,
+ * with set_term() pointing it at the own SCREEN */
+static pthread_mutex_t curses_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* a SCREEN on descriptors of its own, see enter_ncurses() */
+struct screen
+{
+        SCREEN* sp;
+        FILE* in;
+        FILE* out;
+        char term[64];
+        WINDOW* wins[SPARE_WINS];       /* see keep_win() */
+        int n_wins;
+        struct screen* next;
+};
+static struct screen* spare_screens;   /* left by the players gone */
+
+/* ---------------------------------------------------------------------------
+ * what the field shows, from the bottom: heatmap, target, shots, gunsight
+ */
+const int heat_color[N_BUCKETS] = {
+        BLACK_ON_CYAN,
+        BLACK_ON_GREEN,
+        BLACK_ON_YELLOW,
+        BLACK_ON_RED,
+        WHITE_ON_BLACK,
+};
+const char heat_ch[N_BUCKETS] = "#=-. ";
+
+const int shot_color[N_BUCKETS] = {
+        CYAN_ON_BLACK,
+        GREEN_ON_BLACK,
+        YELLOW_ON_BLACK,
+        RED_ON_BLACK,
+        WHITE_ON_BLACK,
+};
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+void ask_options(session* s, game_conf* configuration);
+mtWIN* at_win(session* s);
+bool config_colors(void);
+void blank_win(session* s, mtWIN* window);
+void blit(session* s, mtWIN* window, const struct sprite* sp, int y, int x,
+          int inset, int color);
+void clear_ammo_info(session* s);
+void clear_msg(session* s);
+void cycle_begin(session* s);
+void cycle_end(session* s, int todo);
+void cycle_key(session* s, int key);
+void cycle_ticks(session* s);
+mtWIN* create_win(session* s, int height, int width, int starty, int startx,
+                  int border);
+void destroy_win(session* s, mtWIN* window);
+void display_shots(session* s, game_state* game);
+void draw_border(session* s, mtWIN* window, int color_pair, bool refresh_flag);
+void draw_field_cell(session* s, mtWIN* window, game_state* game, int y, int x);
+void draw_gunsight(session* s, mtWIN* window, point gunsight, int color);
+void draw_heatmap(session* s, mtWIN* window, game_state* game);
+void draw_shot(session* s, point shot, int color);
+void draw_target(session* s, point target);
+void end_frame(session* s);
+int enter_ncurses(session* s, const char* term, FILE* out, FILE* in);
+void erase_gunsight(session* s, mtWIN* window, game_state* game,
+                    point gunsight);
+void exit_ncurses(session* s);
+void flush_gunsight(session* s, game_state* game);
+bool follow_view(session* s, game_state* game, point p);
+void greet(session* s);
+void greet_key(session* s);
+void init_panel(session* s, game_conf* configuration);
+void init_target_area(session* s);
+void init_traffic_lamp(session* s);
+bool keep_win(struct screen* scr, mtWIN* window);
+void light_the_lamp(session* s, int bucket);
+void move_gunsight(session* s, mtWIN* window, game_state* game, point old);
+void mv_info_gunsight(session* s, game_state* game, point old);
+void mv_mtw_addstr_center(mtWIN* window, int y, char* string);
+void next_game(session* s);
+int next_key(session* s, mtWIN* window);
+void options_key(session* s, int key);
+int pace_frame(session* s);
+int play_input(session* s, game_state* game, int input,
+               struct timer* timer);
+void put_cell(session* s, mtWIN* window, int y, int x, chtype ch, int color);
+void put_field(session* s, point p, chtype ch, int color);
+void put_str(session* s, mtWIN* window, int y, int x, const char* str,
+             int color);
+void redraw_field(session* s, game_state* game);
+void refresh_win(session* s, mtWIN* window);
+void replay_arm(session* s, game_state* game, struct timer* timer);
+bool replay_play_game(session* s, game_conf* configuration);
+bool reuse_win(struct screen* scr, mtWIN* window);
+void session_wait(session* s, int timeout);
+void set_msg(session* s, char* message, int color);
+void show_commands(session* s);
+void show_game_over(session* s, game_state* game);
+void show_win(session* s, mtWIN* window);
+void start_game(session* s, game_conf* configuration, game_state* game);
+void toggle_lamp_lights(session* s, int red, int yellow, int green);
+void upd_ammo_info(session* s, game_state* game);
+void upd_time_info(session* s, int time_value);
+bool view_cell(session* s, point* p, int inset);
+int view_start(int p, int view, int field);
+/* -------------------------------------------------------------------------- */
+
+int session_play(session* s, const char* term, FILE* out, FILE* in)
+{
+        /* play on the terminal *term* talking through *in* and *out*, until
+         * the player quits or hangs up, sleeping in between the steps: see
+         * session_start() for *s*. -1 is returned if the terminal can not
+         * be driven.
+         */
+        int delay;
+
+        if (session_start(s, term, out, in) < 0)
+                return -1;
+        while ((delay = session_step(s)) != SESSION_OVER)
+                session_wait(s, delay);
+        session_end(s);
+        return 0;
+}
+
+int session_start(session* s, const char* term, FILE* out, FILE* in)
+{
+        /* open the terminal *term* talking through *in* and *out* and greet
+         * the player, session_step() going on from there. *s* must come
+         * zeroed but for its seed, max_fps, field size, render
+         * (render_curses if none, else one on ncurses) and raw_keys: the
+         * same seed plays the same targets. -1 is returned if the terminal
+         * can not be driven.
+         */
+        struct mallinfo2 heap;
+
+        rng_seed(&s->rng, s->seed);
+        pacer_init(&s->pacer, s->max_fps);
+        if (s->field_height == 0) {
+                s->field_height = FIELD_HEIGHT;
+                s->field_width = FIELD_WIDTH;
+        }
+        if (s->render == NULL)
+                s->render = &render_curses;
+
+        pthread_mutex_lock(&curses_lock);
+        heap = mallinfo2();
+
+        /* start ncurses env -- before this also ncurses structures
+           as `WINDOW' (random sample...!) will not be ready
+         */
+        if (enter_ncurses(s, term, out, in) < 0) {
+                pthread_mutex_unlock(&curses_lock);
+                return -1;
+        }
+        refresh();
+        s->render->open(s);
+
+        s->field = create_win(s, FIELD_HEIGHT, FIELD_WIDTH, 0, 0,
+                              CYAN_ON_BLACK);
+        s->panel = create_win(s, 6, 80, 16, 0, MAGENTA_ON_BLACK);
+        s->lamp = create_win(s, 16, 15, 0, 65, WHITE_ON_BLACK);
+        s->msg = create_win(s, 1, 65, 15, 0, NO_COLOR);
+        s->options = create_win(s, mtLINES-6, mtCOLS-10, 3, 5, NO_COLOR);
+
+        /* what the terminal costs: nobody else allocated meanwhile */
+        s->heap_bytes = mallinfo2().uordblks - heap.uordblks;
+
+        /* the countdown of every game, or the pace of the playback: the
+         * games go on without if there is none */
+        timer_open(&s->timer);
+
+        /* first, the introducing window */
+        if (s->replay) {
+                show_commands(s);
+                next_game(s);
+        }
+        else {
+                greet(s);
+        }
+        pthread_mutex_unlock(&curses_lock);
+        return 0;
+}
+
+int session_step(session* s)
+{
+        /* go on from where the player is with what came since the last
+         * step: the ticks of s->timer, and the keys typed (KEYS_PER_FRAME
+         * at most: a held arrow key moves the gunsight many cells but it
+         * is drawn once); then the frame goes, if it is time. Nothing is
+         * waited for: the milliseconds after which to step again anyway
+         * are returned (0 if keys are left, see pace_frame()), -1 if only
+         * a key or a tick can tell, SESSION_OVER once the player quit or
+         * hung up.
+         */
+        mtWIN* win;
+        int c, delay;
+        int keys = 0;
+
+        pthread_mutex_lock(&curses_lock);
+        set_term(s->scr->sp);
+
+        if (s->at == AT_PLAY && s->timed)
+                cycle_ticks(s);
+        while (keys < KEYS_PER_FRAME && s->at != AT_OVER && !s->closed) {
+                c = next_key(s, at_win(s));
+                if (c == ERR)
+                        break;
+                if (c == KEY_LINK) {
+                        link_answer(&s->link, mono_us());
+                        continue;
+                }
+                keys++;
+                if (s->at == AT_GREET)
+                        greet_key(s);
+                else if (s->at == AT_PLAY)
+                        cycle_key(s, c);
+                else
+                        options_key(s, c);
+        }
+        if (s->closed && s->at == AT_PLAY)
+                cycle_end(s, EXIT_GAME);
+        if (s->closed)
+                s->at = AT_OVER;
+
+        /* what wgetch() would do before the next read, with the raw keys
+         * too: the option asked shows before the player types it */
+        if (s->at != AT_PLAY && s->at != AT_OVER) {
+                win = at_win(s);
+                if (is_wintouched(win->win))
+                        wrefresh(win->win);
+        }
+
+        delay = SESSION_OVER;
+        if (s->at != AT_OVER) {
+                delay = pace_frame(s);
+                if (keys == KEYS_PER_FRAME)
+                        delay = 0;      /* more keys are there */
+        }
+        pthread_mutex_unlock(&curses_lock);
+        return delay;
+}
+
+void session_end(session* s)
+{
+        /* give back everything session_start() took, and let the terminal
+         * go */
+        game_state* game = &s->game;
+
+        pthread_mutex_lock(&curses_lock);
+        set_term(s->scr->sp);
+
+        /* free memory */
+        s->heap_bytes += game->mem.size;
+        game_free(game);
+        if (s->greeting)
+                destroy_win(s, s->greeting);
+        destroy_win(s, s->field);
+        destroy_win(s, s->panel);
+        destroy_win(s, s->lamp);
+        destroy_win(s, s->msg);
+        destroy_win(s, s->options);
+        timer_close(&s->timer);
+
+        /* exit */
+        s->render->close(s);
+        exit_ncurses(s);
+        pthread_mutex_unlock(&curses_lock);
+}
+
+mtWIN* at_win(session* s)
+{
+        /* the window the player is typing on */
+        switch (s->at) {
+        case AT_GREET:
+                return s->greeting;
+        case AT_PLAY:
+                return s->field;
+        default:
+                return s->options;
+        }
+}
+
+void next_game(session* s)
+{
+        /* ask the user the configuration of the next game, or take it
+         * from the recording */
+        if (!s->replay)
+                ask_options(s, &s->conf);
+        else if (replay_play_game(s, &s->conf))
+                cycle_begin(s);
+        else
+                s->at = AT_OVER;
+}
+
+void show_commands(session* s)
+{
+        /* init the available commands in stdscr, bottom line */
+        if (s->term_colors) attron(A_BOLD);
+        mvaddstr(22, 10, "[P]");
+        mvaddstr(22, 20, "[N]");
+        mvaddstr(22, 38, "[U]");
+        mvaddstr(22, 64, "[S]");
+        if (s->term_colors) attroff(A_BOLD);
+        mvaddstr(22, 13, "ausa");
+        mvaddstr(22, 23, "uova partita");
+        mvaddstr(22, 41, "scita");
+        mvaddstr(22, 67, "para!");
+}
+
+void session_open(session* s, const struct render_ops* render)
+{
+        /* set *s* up on *render*, with no terminal, and start a game with
+         * the options in s->conf: session_input() plays it. *s* must come
+         * zeroed but for its seed, options and field size */
+        s->render = render;
+        s->term_colors = TRUE;
+        if (s->conf.level == 0)
+                s->conf.level = 1;
+        if (s->field_height == 0) {
+                s->field_height = FIELD_HEIGHT;
+                s->field_width = FIELD_WIDTH;
+        }
+        rng_seed(&s->rng, s->seed);
+        pacer_init(&s->pacer, s->max_fps);
+
+        render->open(s);
+        s->field = create_win(s, FIELD_HEIGHT, FIELD_WIDTH, 0, 0,
+                              CYAN_ON_BLACK);
+        s->panel = create_win(s, 6, 80, 16, 0, MAGENTA_ON_BLACK);
+        s->lamp = create_win(s, 16, 15, 0, 65, WHITE_ON_BLACK);
+        s->msg = create_win(s, 1, 65, 15, 0, NO_COLOR);
+        session_new_game(s);
+}
+
+void session_new_game(session* s)
+{
+        /* a game after the seed, as cycle_begin() would start it */
+        init_panel(s, &s->conf);
+        init_traffic_lamp(s);
+        init_target_area(s);
+        s->conf.seed = rng_next64(&s->rng);
+        start_game(s, &s->conf, &s->game);
+        end_frame(s);
+}
+
+int session_input(session* s, int input)
+{
+        /* play *input* (IN_*) and draw the frame: its events are returned */
+        int events = play_input(s, &s->game, input, NULL);
+
+        end_frame(s);
+        return events;
+}
+
+void session_close(session* s)
+{
+        game_free(&s->game);
+        destroy_win(s, s->field);
+        destroy_win(s, s->panel);
+        destroy_win(s, s->lamp);
+        destroy_win(s, s->msg);
+        end_frame(s);
+        s->render->close(s);
+}
+
+int enter_ncurses(session* s, const char* term, FILE* out, FILE* in)
+{
+        /* take a spare screen for *term*, or make a new one. A screen
+         * talks through descriptors of its own: the player's ones are
+         * dup2()ed on them, so that the screen can outlive the player */
+        struct screen** link;
+        struct screen* scr;
+        int fd;
+
+        if (term == NULL && (term = getenv("TERM")) == NULL)
+                return -1;
+
+        for (link = &spare_screens; *link; link = &(*link)->next) {
+                if (strcmp((*link)->term, term) == 0)
+                        break;
+        }
+        scr = *link;
+        if (scr != NULL) {
+                *link = scr->next;
+                dup2(fileno(in), fileno(scr->in));
+                dup2(fileno(out), fileno(scr->out));
+                set_term(scr->sp);
+                flushinp();             /* keys left by the last player */
+                clearok(curscr, TRUE);  /* a new terminal shows nothing */
+        }
+        else {
+                scr = calloc(1, sizeof(struct screen));
+                if (scr == NULL) {
+                        fputs("Memory error.", stderr);
+                        exit(1);
+                }
+                snprintf(scr->term, sizeof(scr->term), "%s", term);
+                fd = fcntl(fileno(in), F_DUPFD_CLOEXEC, 0);
+                if (fd >= 0 && (scr->in = fdopen(fd, "r")) == NULL)
+                        close(fd);
+                fd = fcntl(fileno(out), F_DUPFD_CLOEXEC, 0);
+                if (fd >= 0 && (scr->out = fdopen(fd, "w")) == NULL)
+                        close(fd);
+                if (scr->in != NULL && scr->out != NULL)
+                        scr->sp = newterm(scr->term, scr->out, scr->in);
+                if (scr->sp == NULL) {
+                        if (scr->in != NULL)
+                                fclose(scr->in);
+                        if (scr->out != NULL)
+                                fclose(scr->out);
+                        free(scr);
+                        return -1;
+                }
+                /* until a screen has been through endwin() this ncurses
+                 * writes out every cursor motion on its own: the refresh()
+                 * of session_start() takes it back, and from then on a
+                 * doupdate() goes out in one write */
+                endwin();
+        }
+        s->scr = scr;
+        s->in_fd = fileno(scr->in);
+        s->out_fd = fileno(scr->out);
+        link_open(&s->link, s->out_fd);
+
+        raw();          /* these fail on a socket: the client does them */
+        nonl();
+        cbreak();
+        noecho();
+        keypad(stdscr, TRUE);
+        keys_init(&s->keys);
+        curs_set(0);        /* available values: 0, 1, 2. 0 is no cursor */
+        s->term_colors = config_colors();
+        return 0;
+}
+
+bool config_colors()
+{
+        if (has_colors()) {
+                start_color();
+                /* color on black */
+                init_pair(RED_ON_BLACK, COLOR_RED, COLOR_BLACK);
+                init_pair(GREEN_ON_BLACK, COLOR_GREEN, COLOR_BLACK);
+                init_pair(YELLOW_ON_BLACK, COLOR_YELLOW, COLOR_BLACK);
+                init_pair(BLUE_ON_BLACK, COLOR_BLUE, COLOR_BLACK);
+                init_pair(MAGENTA_ON_BLACK, COLOR_MAGENTA, COLOR_BLACK);
+                init_pair(CYAN_ON_BLACK, COLOR_CYAN, COLOR_BLACK);
+                init_pair(WHITE_ON_BLACK, COLOR_WHITE, COLOR_BLACK);
+
+                /* color on white ~ enligh effect */
+                init_pair(BLACK_ON_RED, COLOR_BLACK, COLOR_RED);
+                init_pair(BLACK_ON_GREEN, COLOR_BLACK, COLOR_GREEN);
+                init_pair(BLACK_ON_YELLOW, COLOR_BLACK, COLOR_YELLOW);
+                init_pair(BLACK_ON_BLUE, COLOR_BLACK, COLOR_BLUE);
+                init_pair(BLACK_ON_MAGENTA, COLOR_BLACK, COLOR_MAGENTA);
+                init_pair(BLACK_ON_CYAN, COLOR_BLACK, COLOR_CYAN);
+                init_pair(BLACK_ON_WHITE, COLOR_BLACK, COLOR_WHITE);
+
+                return TRUE;
+        }
+        else {
+                return FALSE;
+        }
+}
+
+void exit_ncurses(session* s)
+{
+        /* this ncurses' delscreen() frees the windows of every screen,
+         * not just its own: the screen is kept for the next player on the
+         * same terminal type instead, cut off from this one */
+        int null = open("/dev/null", O_RDWR | O_CLOEXEC);
+
+        endwin();
+        if (null >= 0) {
+                dup2(null, s->in_fd);
+                dup2(null, s->out_fd);
+                close(null);
+        }
+        s->scr->next = spare_screens;
+        spare_screens = s->scr;
+}
+
+void session_wait(session* s, int timeout)
+{
+        /* sleep, without the ncurses lock, until the player presses
+         * something, s->timer ticks or *timeout* milliseconds go by (if not
+         * -1); the player hanging up closes the session */
+        struct pollfd fds[2];
+
+        fds[0].fd = s->in_fd;
+        fds[0].events = POLLIN | POLLRDHUP;
+        fds[1].fd = s->timer.fd;        /* ignored by poll() when negative */
+        fds[1].events = POLLIN;
+
+        if (poll(fds, 2, timeout) > 0 &&
+            (fds[0].revents & (POLLRDHUP | POLLHUP | POLLERR | POLLNVAL)))
+                s->closed = TRUE;
+}
+
+int next_key(session* s, mtWIN* win)
+{
+        /* the next key typed on *win*, ERR if none is there yet: off
+         * wgetch(), through s->keys for the answers to LINK_PROBE, or off
+         * s->keys reading all there is in one go */
+        int ch;
+
+        s->keys.probing = s->link.probing;
+        if (!s->raw_keys) {
+                wtimeout(win->win, 0);  /* session_wait() does the waiting */
+                if ((ch = keys_next(&s->keys)) != ERR)
+                        return ch;
+                while ((ch = wgetch(win->win)) != ERR) {
+                        if ((ch = keys_feed(&s->keys, ch)) != ERR)
+                                return ch;
+                }
+                return keys_feed(&s->keys, ERR);
+        }
+        while ((ch = keys_next(&s->keys)) == ERR) {
+                if (keys_read(&s->keys, s->in_fd) <= 0)
+                        return ERR;
+        }
+        return ch;
+}
+
+mtWIN* create_win(session* s, int height, int width, int starty, int startx,
+                  int border)
+{
+        /* init a mtWIN data structure, with a window of the session's
+         * backend, and draw a border if *border* flag is set to a NCURSES
+         * COLOR PAIR value
+         */
+        mtWIN* magic_target_window = calloc(1, sizeof(mtWIN));
+
+        if (magic_target_window == NULL) {
+                fputs("Memory error.", stderr);
+                exit(1);
+        }
+        magic_target_window->border = border;
+        magic_target_window->height = height;
+        magic_target_window->width = width;
+        magic_target_window->y = starty;
+        magic_target_window->x = startx;
+        if (s->scr != NULL)
+                reuse_win(s->scr, magic_target_window);
+        s->render->newwin(s, magic_target_window);
+
+        draw_border(s, magic_target_window, border, FALSE);
+
+        return magic_target_window;
+}
+
+void draw_border(session* s, mtWIN* win, int color_pair, bool refresh)
+{
+        /* a box of *color_pair*, hidden when it is NO_COLOR */
+        s->render->outline(s, win, color_pair);
+        win->border = color_pair;
+
+        if (refresh)
+                refresh_win(s, win);
+}
+void show_win(session* s, mtWIN* win)
+{
+        /* Refresh and show the window even if there were no modifications
+         */
+
+        s->render->touch(s, win); /* every char is taken as new  */
+        refresh_win(s, win);      /* in order to refresh them on the screen */
+}
+
+void refresh_win(session* s, mtWIN* win)
+{
+        /* mark *win* to be sent to the screen by the next end_frame() */
+        s->render->mark(s, win);
+        s->frame_pending = TRUE;
+        stats_add(marks, 1);
+}
+
+void end_frame(session* s)
+{
+        /* send every window marked by refresh_win() at once: on ncurses
+         * a single write for everything that changed. On a terminal a
+         * probe may follow, see struct link */
+        uint64_t now;
+
+        flush_gunsight(s, &s->game);
+        if (s->frame_pending) {
+                s->render->flush(s);
+                s->frame_pending = FALSE;
+                stats_add(flushes, 1);
+                now = mono_us();
+                if (s->pacer.interval)
+                        pacer_mark(&s->pacer, now);
+                if (s->scr && link_probe(&s->link, now) &&
+                    write(s->out_fd, LINK_PROBE, strlen(LINK_PROBE)) < 0)
+                        s->link.probing = FALSE;
+        }
+}
+
+int pace_frame(session* s)
+{
+        /* end_frame(), unless the last frame went less than a frame
+         * interval ago (see s->max_fps) or the terminal is behind (see
+         * struct link): then the frame waits, and how many milliseconds is
+         * returned. -1 if nothing waits */
+        uint64_t now = mono_us();
+        int delay;
+
+        flush_gunsight(s, &s->game);
+        if (!s->frame_pending)
+                return -1;
+        if (s->pacer.interval &&
+            (delay = pacer_delay_ms(&s->pacer, now)) > 0)
+                return delay;
+        if ((delay = link_delay_ms(&s->link, now)) > 0)
+                return delay;
+        end_frame(s);
+        stats_frame_end();
+        return -1;
+}
+
+void destroy_win(session* s, mtWIN* win)
+{
+        /* blank *win* on the screen by the next frame, and free it */
+        blank_win(s, win);
+        refresh_win(s, win);
+        if (s->scr != NULL)
+                keep_win(s->scr, win);
+        s->render->delwin(s, win);
+        free(win);
+}
+
+bool keep_win(struct screen* scr, mtWIN* win)
+{
+        /* keep the window of *win*, blank, for the next player on *scr*:
+         * delwin() looks for it among the windows of every screen, which
+         * with thousands of players costs more than the whole game. The
+         * backend's delwin() gets what is left of *win* */
+        if (scr->n_wins == SPARE_WINS)
+                return FALSE;
+        scr->wins[scr->n_wins++] = win->win;
+        win->win = NULL;
+        return TRUE;
+}
+
+bool reuse_win(struct screen* scr, mtWIN* win)
+{
+        /* give *win* a window kept by keep_win() of its size and place,
+         * for the backend's newwin() to take */
+        WINDOW* w;
+        int i;
+
+        for (i=0; i<scr->n_wins; i++) {
+                w = scr->wins[i];
+                if (getmaxy(w) == win->height && getmaxx(w) == win->width &&
+                    getbegy(w) == win->y && getbegx(w) == win->x) {
+                        scr->wins[i] = scr->wins[--scr->n_wins];
+                        wattrset(w, A_NORMAL);
+                        wmove(w, 0, 0);
+                        win->win = w;
+                        return TRUE;
+                }
+        }
+        return FALSE;
+}
+
+void mv_mtw_addstr_center(mtWIN* win, int y, char* string)
+{
+        int x_pos = floor(win->width / 2) - ceil(strlen(string) / 2);
+
+        if (x_pos < 0) {
+                if (win->border) {
+                        string[win->width-2] = '\0';
+                        x_pos = 1;
+                }
+                else {
+                        string[win->width] = '\0';
+                        x_pos = 0;
+                }
+        }
+        mvwaddstr(win->win, y, x_pos, string);
+}
+
+void greet(session* s)
+{
+        /* Build a window with the program title, and some notes to introduce
+         * Magic Target to the user: it stays until a key, see greet_key().
+         */
+
+        mtWIN* greet_win = create_win(s, mtLINES, mtCOLS, 0, 0, RED_ON_BLACK);
+        char* title[] = {
+                "C Magic Target - v2.0",
+                "(C) 2014 Daniele Zanotelli - dazano@gmail.com",
+        };
+
+        char* descr[] = {
+                "Questo e` un remake di QuickBasic Magic Target, scritto",
+                "in adolescenza. Questa versione, reimplementata in C,",
+                "e` dedicata a mio cugino Federico, unico utente della prima",
+                "versione il quale ha apprezzato cosi` tanto la scritta",
+                "``!! BINATO !!'' che appariva quando il bersagio veniva",
+                "centrato.",
+        };
+        char* sentence;
+        int i = 0;
+        int selected_color;
+        size_t title_len = sizeof(title)/sizeof(title[0]);
+        size_t descr_len = sizeof(descr)/sizeof(descr[0]);
+
+        for (i=0; i<title_len; i++) {
+                if (s->term_colors) {
+                        switch (i) {
+                        case 0:
+                                selected_color = BLUE_ON_BLACK;
+                                break;
+                        case 1:
+                                selected_color = CYAN_ON_BLACK;
+                                break;
+                        default:
+                                selected_color = WHITE_ON_BLACK;
+                        }
+                        wattron(greet_win->win, COLOR_PAIR(selected_color));
+                }
+
+                mv_mtw_addstr_center(greet_win, 5+i+i%2, title[i]);
+
+                if (s->term_colors)
+                        wattroff(greet_win->win, COLOR_PAIR(selected_color));
+        }
+
+        for (i=0; i<descr_len; i++)
+                mv_mtw_addstr_center(greet_win, 12+i, descr[i]);
+
+        wrefresh(greet_win->win);
+        s->greeting = greet_win;
+        s->at = AT_GREET;
+}
+
+void greet_key(session* s)
+{
+        /* any key: the greeting goes, the options come */
+        destroy_win(s, s->greeting);
+        s->greeting = NULL;
+        show_commands(s);
+        next_game(s);
+}
+
+void ask_options(session* s, game_conf* conf)
+{
+        /* draw the options of the next game, the last ones as defaults,
+         * and start asking them: the user name, the difficulty level and
+         * if she/he wants the timer switch on or off. options_key() takes
+         * the answers, a key at a time
+         */
+        int i;
+        char title[] = "Opzioni di gioco:";
+        mtWIN* win = s->options;
+
+        char* label[] = {
+                "Nome Giocatore     :",
+                "Difficolta` (1-3/A):",
+                "Tempo (si/no)      :"
+        };
+        char lvl_field[2];
+        const char* field_default[3];
+
+        /* the window is the session's, blank since the last time */
+        draw_border(s, win, MAGENTA_ON_BLACK, FALSE);
+
+        /* adjust defaults with old data */
+        if (strlen(conf->player_name)) field_default[0] = conf->player_name;
+        else field_default[0] = PN_DEFAULT;
+        sprintf(lvl_field, "%c", LEVEL_CH(conf->level ? conf->level : 1));
+        field_default[1] = lvl_field;
+        field_default[2] = conf->timer ? "si" : "no";
+
+        /* print title in the main window */
+        mv_mtw_addstr_center(win, 2, title);
+
+        /* print fields and defaults */
+        for (i=0; i<3; i++) {
+                if (s->term_colors) wattron(win->win, A_BOLD);
+                mvwaddstr(win->win, OPTION_Y(i), OPTION_X-21, label[i]);
+                if (s->term_colors) wattroff(win->win, A_BOLD);
+                mvwaddstr(win->win, OPTION_Y(i), OPTION_X, field_default[i]);
+        }
+
+        /* 1: ask player name */
+        curs_set(1);
+        wmove(win->win, OPTION_Y(0), OPTION_X);
+        wrefresh(win->win);
+        s->form.len = 0;
+        s->at = AT_NAME;
+}
+
+void options_key(session* s, int ch)
+{
+        /* the key *ch* typed on the option being asked: Enter takes it
+         * and asks the next one, the last Enter waits for a key to start
+         * the game */
+        struct options_form* form = &s->form;
+        game_conf* conf = &s->conf;
+        WINDOW* win = s->options->win;
+        int i;
+
+        switch (s->at) {
+        case AT_NAME:
+                if (ch == 13) {
+                        if (form->len == 0) {
+                                if (!strlen(conf->player_name))
+                                        strcpy(conf->player_name, PN_DEFAULT);
+                                mvwaddstr(win, OPTION_Y(0), OPTION_X,
+                                          conf->player_name);
+                        }
+                        else {
+                                form->name[form->len] = '\0';
+                                strcpy(conf->player_name, form->name);
+                        }
+
+                        /* 2: ask difficulty */
+                        wattron(win, COLOR_PAIR(CYAN_ON_BLACK));
+                        mvwaddstr(win, OPTION_Y(1), 30,
+                                  "Usa le frecce <- e -> (A: allenamento)");
+                        wattroff(win, COLOR_PAIR(CYAN_ON_BLACK));
+                        wmove(win, OPTION_Y(1), OPTION_X);
+                        form->choice = conf->level ? conf->level : 1;
+                        s->at = AT_LEVEL;
+                        break;
+                }
+
+                // delete default value from screen
+                if (form->len == 0) {
+                        for (i=0; i<MAX_PN_LEN-1; i++)
+                                mvwaddch(win, OPTION_Y(0), OPTION_X+i, ' ');
+                        wmove(win, OPTION_Y(0), OPTION_X);
+                }
+
+                switch (ch) {
+                case KEY_BACKSPACE:
+                        if (form->len > 0) {
+                                form->len--;
+                                mvwaddch(win, OPTION_Y(0),
+                                         OPTION_X+form->len, ' ');
+                                wmove(win, OPTION_Y(0), OPTION_X+form->len);
+                        }
+                        break;
+                default:
+                        if (form->len < MAX_PN_LEN-1 &&
+                            (isalnum(ch) || ch == ' ')) {
+                                mvwaddch(win, OPTION_Y(0),
+                                         OPTION_X+form->len, ch);
+                                form->name[form->len++] = ch;
+                        }
+                        break;
+                }
+                wrefresh(win);
+                break;
+
+        case AT_LEVEL:
+                if (ch == 13) {
+                        mvwaddstr(win, OPTION_Y(1), 30,
+                                  "                                      ");
+                        conf->level = form->choice;
+
+                        /* 3: ask if switch on time */
+                        wattron(win, COLOR_PAIR(CYAN_ON_BLACK));
+                        mvwaddstr(win, OPTION_Y(2), 30,
+                                  "Usa le frecce <- e ->");
+                        wattroff(win, COLOR_PAIR(CYAN_ON_BLACK));
+                        wmove(win, OPTION_Y(2), OPTION_X+2);
+                        form->choice = conf->timer;
+                        s->at = AT_TIMER;
+                        break;
+                }
+                switch (ch) {
+                case KEY_LEFT:
+                        form->choice--;
+                        break;
+                case KEY_RIGHT:
+                        form->choice++;
+                        break;
+                }
+                if (form->choice < 1)
+                        form->choice = LEVEL_PRACTICE;
+                else if (form->choice > LEVEL_PRACTICE)
+                        form->choice = 1;
+                mvwaddch(win, OPTION_Y(1), OPTION_X, LEVEL_CH(form->choice));
+                break;
+
+        case AT_TIMER:
+                if (ch == 13) {
+                        conf->timer = form->choice;
+                        mvwaddstr(win, OPTION_Y(2), 30,
+                                  "                     ");
+
+                        if (s->term_colors) wattron(win, A_BOLD);
+                        mv_mtw_addstr_center(s->options, 15,
+                                "Premere un tasto qualsiasi per iniziare");
+                        if (s->term_colors) wattroff(win, A_BOLD);
+                        s->at = AT_READY;
+                        break;
+                }
+                switch (ch) {
+                case KEY_LEFT:
+                case KEY_RIGHT:
+                        form->choice = !form->choice;
+                        mvwaddstr(win, OPTION_Y(2), OPTION_X,
+                                  form->choice ? "si" : "no");
+                        break;
+                }
+                break;
+
+        case AT_READY:
+                /* exit: blank the window on the screen, for the next time */
+                blank_win(s, s->options);
+                refresh_win(s, s->options);
+                curs_set(0);
+                cycle_begin(s);
+                break;
+        }
+}
+
+
+void init_panel(session* s, game_conf* conf)
+{
+        /* init the panel with the player name, the timer info and ammos
+         */
+
+        mtWIN* panel = s->panel;
+        int i;
+
+        /* labels */
+        put_str(s, panel, 2, 3, "Giocatore:", BLUE_ON_BLACK);
+        put_str(s, panel, 2, 33, "Liv.:", BLUE_ON_BLACK);
+        put_str(s, panel, 2, 42, "Tempo:", BLUE_ON_BLACK);
+        put_str(s, panel, 4, 33, "x:", BLUE_ON_BLACK);
+        put_str(s, panel, 4, 42, "y:", BLUE_ON_BLACK);
+        /* values */
+        put_str(s, panel, 2, 14, conf->player_name, RED_ON_BLACK);
+        put_cell(s, panel, 2, 39, LEVEL_CH(conf->level), RED_ON_BLACK);
+        put_str(s, panel, 2, 49, "--", RED_ON_BLACK);
+
+        /* veritical line */
+        for (i=1; i<panel->height-1; i++)
+                put_cell(s, panel, i, 57, LINE_VLINE, panel->border);
+        put_cell(s, panel, 0, 57, LINE_TTEE, panel->border);
+        put_cell(s, panel, panel->height-1, 57, LINE_BTEE, panel->border);
+
+        /* init ammos */
+        put_str(s, panel, 1, 67, "AMMO", BLUE_ON_BLACK);
+        show_win(s, panel);
+}
+void upd_time_info(session* s, int time_value)
+{
+        char time_str[] = "00";
+
+        sprintf(time_str, "%02i", time_value);
+        put_str(s, s->panel, 2, 49, time_str, RED_ON_BLACK);
+        refresh_win(s, s->panel);
+}
+
+void clear_ammo_info(session* s)
+{
+        int row;
+
+        for (row=2; row<5; row++)
+                put_str(s, s->panel, row, 59, "                   ", NO_COLOR);
+}
+
+void upd_ammo_info(session* s, game_state* game)
+{
+        int i, col, row;
+        char ammo_ch = '*';
+        char ammo_used_ch = '-';
+        int color = RED_ON_BLACK;
+        char str[20];
+
+        /* practice: no ammo to count, the shots fired instead */
+        if (game->ammo_tot == 0) {
+                put_str(s, s->panel, 2, 64, "illimitate", RED_ON_BLACK);
+                sprintf(str, "%8d colpi", game->shots.len);
+                put_str(s, s->panel, 3, 61, str, RED_ON_BLACK);
+                refresh_win(s, s->panel);
+                return;
+        }
+
+        row = 2;
+        col = 0;
+        for (i=1; i<=game->ammo_tot; i++) {
+                if (col > 9) {
+                        col = 0;
+                        row++;
+                }
+                if (i > game->ammo_left) {
+                        if (s->term_colors)
+                                color = NO_COLOR;
+                        else
+                                ammo_ch = ammo_used_ch;
+                }
+                put_cell(s, s->panel, row, 59 + col*2, ammo_ch, color);
+                col++;
+        }
+        refresh_win(s, s->panel);
+}
+
+
+void init_traffic_lamp(session* s)
+{
+        toggle_lamp_lights(s, FALSE, FALSE, FALSE);
+        show_win(s, s->lamp);
+}
+
+void light_the_lamp(session* s, int bucket)
+{
+        switch (bucket) {
+        case BUCKET_HIT:
+                toggle_lamp_lights(s, MAGENTA_ON_BLACK,
+                                   MAGENTA_ON_BLACK,
+                                   MAGENTA_ON_BLACK
+                        );
+                break;
+        case BUCKET_NEAR:
+                toggle_lamp_lights(s, NO_COLOR, NO_COLOR, GREEN_ON_BLACK);
+                break;
+        case BUCKET_MID:
+                toggle_lamp_lights(s, NO_COLOR, YELLOW_ON_BLACK, NO_COLOR);
+                break;
+        case BUCKET_FAR:
+                toggle_lamp_lights(s, RED_ON_BLACK, NO_COLOR, NO_COLOR);
+                break;
+        default:
+                toggle_lamp_lights(s, NO_COLOR, NO_COLOR, NO_COLOR);
+                break;
+        }
+
+        refresh_win(s, s->lamp);
+}
+
+void toggle_lamp_lights(session* s, int first, int second, int third)
+{
+        /* activate or deactivate lamp lights, the *first* on top, in the
+         * color given: a light off is white with no face
+         */
+        int color[3];
+        int i;
+
+        color[0] = first;
+        color[1] = second;
+        color[2] = third;
+        for (i=0; i<3; i++) {
+                if (color[i])
+                        blit(s, s->lamp, &sprite_light[i], 1 + 5*i, 3, 0,
+                             color[i]);
+                else
+                        blit(s, s->lamp, &sprite_light_off, 1 + 5*i, 3, 0,
+                             WHITE_ON_BLACK);
+        }
+}
+void init_target_area(session* s)
+{
+        blank_win(s, s->field);
+        show_win(s, s->field);
+}
+
+void show_game_over(session* s, game_state* game)
+{
+        switch (game->status) {
+        case GAME_WIN:
+                set_msg(s, "!!! BINATO !!!", MAGENTA_ON_BLACK);
+                break;
+        case GAME_LOSE:
+                set_msg(s, "Hai perso...", CYAN_ON_BLACK);
+                break;
+        }
+        s->show_target = TRUE;
+        follow_view(s, game, game->target);
+        redraw_field(s, game);
+}
+
+void cycle_begin(session* s)
+{
+        /* start a game with s->conf, and drive it from now on: the keys
+         * pressed by the player go to cycle_key(), the ticks of s->timer
+         * to cycle_ticks(). The timer is the countdown, or the pace of
+         * the inputs of a recording being played back
+         */
+        game_conf* conf = &s->conf;
+        game_state* game = &s->game;
+
+        /* init */
+        init_panel(s, conf);
+        init_traffic_lamp(s);
+        init_target_area(s);
+
+        /* print available commands in the bottom line */
+        wnoutrefresh(stdscr);
+
+        /* every game its own targets, all following the seed */
+        if (!s->replay)
+                conf->seed = rng_next64(&s->rng);
+        start_game(s, conf, game);
+        if (s->rec)
+                replay_game(s->rec, conf, game->height, game->width,
+                            mono_ms());
+
+        /* set up timer: with none the game goes on without */
+        s->timed = (game->timer || s->replay) && s->timer.fd >= 0;
+        if (s->timed) {
+                if (s->replay)
+                        replay_arm(s, game, &s->timer);
+                else
+                        timer_start_ticks(&s->timer);
+        }
+        s->paused = FALSE;
+        s->at = AT_PLAY;
+        stats_frame_begin();
+}
+
+void cycle_ticks(session* s)
+{
+        /* the ticks of s->timer since the last step: a second of the
+         * countdown each, or the next input of the recording */
+        game_state* game = &s->game;
+        uint64_t ticks = timer_expired(&s->timer);
+
+        if (ticks == 0)
+                return;
+        if (s->replay) {
+                play_input(s, game, s->replay_input, NULL);
+                replay_arm(s, game, &s->timer);
+                return;
+        }
+        while (ticks-- && game->status == GAME_RUNNING)
+                play_input(s, game, IN_TICK, &s->timer);
+}
+
+void cycle_key(session* s, int c)
+{
+        /* the key *c* pressed while playing: drive the game_state with it,
+         * and show on the screen what changed */
+        game_state* game = &s->game;
+        int input;
+        char hint_msg[32];
+        point hint;
+
+        stats_key();
+
+        /* while paused only 'p' is heard, once the game is over
+         * only a new game or the exit */
+        if (s->paused) {
+                if (c != 'p' && c != 'P')
+                        return;
+                s->paused = FALSE;
+                clear_msg(s);
+                /* the countdown goes on where it was left */
+                if (s->timed)
+                        timer_resume(&s->timer);
+                return;
+        }
+        if (game->status > GAME_RUNNING &&
+            c != 'n' && c != 'N' && c != 'u' && c != 'U')
+                return;
+
+        /* key pressed management */
+        input = IN_NONE;
+        switch (c) {
+        case 'u':
+        case 'U':
+                cycle_end(s, EXIT_GAME);
+                return;
+        case 'n':
+        case 'N':
+                cycle_end(s, NEW_GAME);
+                return;
+        case 'p':
+        case 'P':
+                s->paused = TRUE;
+                set_msg(s, "IN PAUSA", CYAN_ON_BLACK);
+                if (s->timed)
+                        timer_pause(&s->timer);
+                break;
+        case KEY_UP:
+                input = IN_UP;
+                break;
+        case KEY_RIGHT:
+                input = IN_RIGHT;
+                break;
+        case KEY_DOWN:
+                input = IN_DOWN;
+                break;
+        case KEY_LEFT:
+                input = IN_LEFT;
+                break;
+        case 's':
+        case 'S':
+                input = IN_SHOOT;
+                break;
+        case 'C':
+                s->show_target = TRUE;
+                follow_view(s, game, game->target);
+                redraw_field(s, game);
+                s->show_target = FALSE;
+                s->peeked = TRUE;
+                set_msg(s, "!!! IMBROGLIONE !!!", RED_ON_BLACK);
+                break;
+        case 'H':
+                s->show_heatmap = !s->show_heatmap;
+                redraw_field(s, game);
+                break;
+        case 'a':
+        case 'A':
+                if (s->replay || game->status != GAME_RUNNING)
+                        break;
+                if (hint_next(game, &hint))
+                        sprintf(hint_msg, "Prova a X %02i Y %02i",
+                                hint.x, hint.y);
+                else
+                        strcpy(hint_msg, "Non saprei...");
+                set_msg(s, hint_msg, GREEN_ON_BLACK);
+                break;
+        default:
+                break;
+        }
+
+        /* a recording is only watched */
+        if (input == IN_NONE || s->replay)
+                return;
+
+        /* the cheat shows the target until the gunsight moves, with the
+         * view back around it */
+        if (s->peeked && input != IN_SHOOT) {
+                s->peeked = FALSE;
+                if (!s->show_target) {
+                        follow_view(s, game, game->gunsight);
+                        redraw_field(s, game);
+                }
+        }
+
+        /* the frame held back for the terminal will not be seen:
+         * this one goes in its place */
+        if (s->link.held && s->frame_pending) {
+                s->link.dropped++;
+                stats_add(dropped, 1);
+        }
+        play_input(s, game, input, s->timed ? &s->timer : NULL);
+}
+
+void cycle_end(session* s, int todo)
+{
+        /* leave the game: on to the next one if *todo* is NEW_GAME */
+        end_frame(s);
+        if (s->rec)
+                replay_end(s->rec, &s->game, mono_ms());
+        if (s->timed)
+                timer_stop(&s->timer);
+        s->timed = FALSE;
+
+        if (todo == NEW_GAME && !s->closed)
+                next_game(s);
+        else
+                s->at = AT_OVER;
+}
+
+void start_game(session* s, game_conf* conf, game_state* game)
+{
+        /* get a random target, the gunsight and ammos, and show them */
+        game_init(game, conf, s->field_height, s->field_width);
+
+        /* update ammos */
+        clear_ammo_info(s);
+        upd_ammo_info(s, game);
+
+        /* init the gunsight, and the view around it */
+        s->gunsight_moved = FALSE;
+        s->show_target = s->peeked = FALSE;
+        s->view.y = s->view.x = 0;
+        follow_view(s, game, game->gunsight);
+        redraw_field(s, game);
+}
+
+int play_input(session* s, game_state* game, int input,
+               struct timer* timer)
+{
+        /* feed *input* to the game, record it and show what changed; the
+         * countdown on *timer* (if any) stops with the game. The events of
+         * the game are returned */
+        point old_gunsight = game->gunsight;
+        int events;
+
+        /* what comes next is drawn over the gunsight where it is now */
+        if (input < IN_UP || input > IN_LEFT)
+                flush_gunsight(s, game);
+
+        if (s->rec && game->status == GAME_RUNNING)
+                replay_input(s->rec, input, mono_ms());
+        events = game_step(game, input);
+
+        if (events & EV_TIME)
+                upd_time_info(s, game->game_time);
+
+        if (events & EV_NEW_TARGET) {
+                if (events & EV_SHOT)
+                        set_msg(s, "Preso! Nuovo bersaglio", GREEN_ON_BLACK);
+                else
+                        set_msg(s, "Nuovo bersaglio!!!", RED_ON_BLACK);
+                s->show_target = FALSE;
+                redraw_field(s, game);
+        }
+
+        /* the moves are drawn all at once, by the next frame */
+        if ((events & EV_GUNSIGHT) && !s->gunsight_moved) {
+                s->gunsight_from = old_gunsight;
+                s->gunsight_moved = TRUE;
+        }
+
+        if (events & EV_SHOT) {
+                upd_ammo_info(s, game);
+                light_the_lamp(s, distance_bucket(game->dist));
+
+                /* only the cell shot at changes, if the shot is the
+                 * first there */
+                draw_field_cell(s, s->field, game, game->gunsight.y,
+                                game->gunsight.x);
+                refresh_win(s, s->field);
+        }
+
+        if (events & EV_OVER) {
+                if (timer && timer->fd >= 0)
+                        timer_stop(timer);
+                show_game_over(s, game);
+        }
+        return events;
+}
+
+void replay_arm(session* s, game_state* game, struct timer* timer)
+{
+        /* read the next input of the game being played back, and set
+         * *timer* to go off when it is due */
+        struct replay_rec rec;
+
+        rec.type = 0;
+        if (replay_next(s->replay, &rec) > 0 && rec.type == REPLAY_INPUT) {
+                s->replay_input = rec.input;
+                timer_after(timer, rec.dt * 1000);
+                return;
+        }
+
+        /* this game is over: the next one is for replay_play_game() */
+        if (rec.type == REPLAY_GAME)
+                replay_unread(s->replay);
+        if (game->status == GAME_RUNNING)
+                set_msg(s, "Fine della registrazione", CYAN_ON_BLACK);
+}
+
+bool replay_play_game(session* s, game_conf* conf)
+{
+        /* find the next game of the recording being played back */
+        struct replay_rec rec;
+
+        while (replay_next(s->replay, &rec) > 0) {
+                if (rec.type == REPLAY_GAME) {
+                        *conf = rec.conf;
+                        s->field_height = rec.height;
+                        s->field_width = rec.width;
+                        return TRUE;
+                }
+        }
+        return FALSE;
+}
+
+void draw_gunsight(session* s, mtWIN* win, point gs, int color)
+{
+        /* the gunsight at the field cell *gs*: being kept away from the
+         * edges of the view, it only reaches the border of the window at
+         * the border of the field */
+        if (view_cell(s, &gs, 0))
+                blit(s, win, &sprite_gunsight, gs.y, gs.x, 0, color);
+}
+
+void erase_gunsight(session* s, mtWIN* win, game_state* game, point gs)
+{
+        /* put back what the gunsight was covering */
+        draw_field_cell(s, win, game, gs.y, gs.x-2);
+        draw_field_cell(s, win, game, gs.y, gs.x+2);
+        draw_field_cell(s, win, game, gs.y-1, gs.x);
+        draw_field_cell(s, win, game, gs.y+1, gs.x);
+}
+
+void move_gunsight(session* s, mtWIN* win, game_state* game, point old)
+{
+        /* only the cells of the old and the new gunsight are touched, so
+         * ncurses has just a handful of characters to send; unless the
+         * view has to scroll, and is drawn again */
+        if (follow_view(s, game, game->gunsight)) {
+                redraw_field(s, game);
+                return;
+        }
+        erase_gunsight(s, win, game, old);
+        draw_gunsight(s, win, game->gunsight, CYAN_ON_BLACK);
+        refresh_win(s, win);
+}
+
+void flush_gunsight(session* s, game_state* game)
+{
+        /* draw the gunsight where the moves since the last frame took it,
+         * if anywhere else */
+        point from = s->gunsight_from;
+
+        if (!s->gunsight_moved)
+                return;
+        s->gunsight_moved = FALSE;
+        if (from.y != game->gunsight.y || from.x != game->gunsight.x)
+                mv_info_gunsight(s, game, from);
+}
+
+int view_start(int p, int view, int field)
+{
+        /* where a view *view* long starts on a field *field* long, to be
+         * centered on *p* as far as the field goes: always 0 when the
+         * field fits */
+        int start = p - view / 2;
+
+        if (start > field - view)
+                start = field - view;
+        if (start < 0)
+                start = 0;
+        return start;
+}
+
+bool follow_view(session* s, game_state* game, point p)
+{
+        /* scroll the view, if the field cell *p* is too near to its edges
+         * or out of it, so that *p* comes to the middle: TRUE if it moved.
+         * Scrolling half a window at once, it seldom has to */
+        mtWIN* win = s->field;
+        point v = s->view;
+
+        if (p.y - v.y < VIEW_MARGIN_Y ||
+            p.y - v.y >= win->height - VIEW_MARGIN_Y)
+                v.y = view_start(p.y, win->height, game->height);
+        if (p.x - v.x < VIEW_MARGIN_X ||
+            p.x - v.x >= win->width - VIEW_MARGIN_X)
+                v.x = view_start(p.x, win->width, game->width);
+
+        if (v.y == s->view.y && v.x == s->view.x)
+                return FALSE;
+        s->view = v;
+        return TRUE;
+}
+
+bool view_cell(session* s, point* p, int inset)
+{
+        /* turn the field cell *p* into the cell of the field window which
+         * shows it: FALSE if that falls out of the window, or within
+         * *inset* cells of its edges */
+        p->y -= s->view.y;
+        p->x -= s->view.x;
+        return p->y >= inset && p->x >= inset &&
+                p->y < s->field->height - inset &&
+                p->x < s->field->width - inset;
+}
+
+void mv_info_gunsight(session* s, game_state* game, point old)
+{
+        char str[12];
+        point gs = game->gunsight;
+
+        /* redraw the gunsight */
+        move_gunsight(s, s->field, game, old);
+
+        /* update coords on the panel, room for FIELD_MAX */
+        sprintf(str, "%-4.2i", gs.x);
+        put_str(s, s->panel, 4, 36, str, RED_ON_BLACK);
+        sprintf(str, "%-4.2i", gs.y);
+        put_str(s, s->panel, 4, 45, str, RED_ON_BLACK);
+        refresh_win(s, s->panel);
+}
+
+void put_cell(session* s, mtWIN* win, int y, int x, chtype ch, int color)
+{
+        s->render->put(s, win, y, x, ch, color);
+        stats_add(cells, 1);
+}
+
+void put_field(session* s, point p, chtype ch, int color)
+{
+        /* put_cell() at the field cell *p*, if in view inside the border */
+        if (view_cell(s, &p, 1))
+                put_cell(s, s->field, p.y, p.x, ch, color);
+}
+
+void blit(session* s, mtWIN* win, const struct sprite* sp, int y, int x,
+          int inset, int color)
+{
+        /* draw *sp* in *win* with its center at *y*, *x*, in *color*: each
+         * run of cells which are not transparent with one write, leaving
+         * out what falls within *inset* cells of the edges of *win*
+         */
+        const chtype* row;
+        int top = y - sp->cy;
+        int left = x - sp->cx;
+        int r, c, end, from, to;
+
+        for (r=0; r<sp->height; r++) {
+                if (top + r < inset || top + r >= win->height - inset)
+                        continue;
+                row = &sp->cells[r * sp->width];
+                for (c=0; c<sp->width; c=end) {
+                        while (c < sp->width && row[c] == 0)
+                                c++;
+                        for (end=c; end < sp->width && row[end]; end++)
+                                ;
+
+                        /* the run c..end, clipped */
+                        from = left + c < inset ? inset - left : c;
+                        to = left + end > win->width - inset ?
+                                win->width - inset - left : end;
+                        if (from < to) {
+                                s->render->putn(s, win, top + r, left + from,
+                                                &row[from], to - from, color);
+                                stats_add(cells, to - from);
+                        }
+                }
+        }
+}
+
+void put_str(session* s, mtWIN* win, int y, int x, const char* str,
+             int color)
+{
+        s->render->puts(s, win, y, x, str, color);
+        stats_add(cells, strlen(str));
+}
+
+void blank_win(session* s, mtWIN* win)
+{
+        s->render->blank(s, win);
+        stats_add(blanks, 1);
+}
+
+void draw_field_cell(session* s, mtWIN* win, game_state* game, int y, int x)
+{
+        /* repaint the field cell at *y*, *x* with what it shows when the
+         * gunsight is not over it, if it is in view
+         */
+        struct shot_buf* shots = &game->shots;
+        int bottom = win->height-1;
+        int right = win->width-1;
+        int i, bucket;
+        chtype ch;
+        point p, q;
+
+        q.y = p.y = y;
+        q.x = p.x = x;
+        if (!view_cell(s, &p, 0))
+                return;
+
+        /* window border */
+        if (p.y == 0 || p.x == 0 || p.y == bottom || p.x == right) {
+                if (!win->border)
+                        ch = ' ';
+                else if (p.x == 0)
+                        ch = p.y == 0 ? LINE_ULCORNER :
+                                p.y == bottom ? LINE_LLCORNER : LINE_VLINE;
+                else if (p.x == right)
+                        ch = p.y == 0 ? LINE_URCORNER :
+                                p.y == bottom ? LINE_LRCORNER : LINE_VLINE;
+                else
+                        ch = LINE_HLINE;
+                put_cell(s, win, p.y, p.x, ch, win->border);
+                return;
+        }
+
+        /* shots: the first one at a cell is the one shown */
+        if ((i = shot_at(game, q)) >= 0) {
+                put_cell(s, win, p.y, p.x, '+', shot_color[shots->bucket[i]]);
+                return;
+        }
+
+        if (s->show_target && (ch = sprite_cell(&sprite_target,
+                                                y - game->target.y,
+                                                x - game->target.x))) {
+                put_cell(s, win, p.y, p.x, ch, MAGENTA_ON_BLACK);
+                return;
+        }
+
+        if (s->show_heatmap) {
+                bucket = target_bucket(game, q);
+                put_cell(s, win, p.y, p.x, heat_ch[bucket],
+                         heat_color[bucket]);
+        }
+        else {
+                put_cell(s, win, p.y, p.x, ' ', NO_COLOR);
+        }
+}
+
+void redraw_field(session* s, game_state* game)
+{
+        /* repaint the field in view, every layer, from scratch */
+        blank_win(s, s->field);
+        draw_border(s, s->field, s->field->border, FALSE);
+        if (s->show_heatmap)
+                draw_heatmap(s, s->field, game);
+        if (s->show_target)
+                draw_target(s, game->target);
+        display_shots(s, game);
+        if (game->status == GAME_RUNNING)
+                draw_gunsight(s, s->field, game->gunsight, CYAN_ON_BLACK);
+        refresh_win(s, s->field);
+}
+
+void draw_target(session* s, point target)
+{
+        /* draw the target on the game window. the *target* x and y values
+         * will be the coords for the center, see sprite_target: what falls
+         * on the border or out of the view is left out
+         */
+        view_cell(s, &target, 0);
+        blit(s, s->field, &sprite_target, target.y, target.x, 1,
+             MAGENTA_ON_BLACK);
+
+        refresh_win(s, s->field);
+}
+
+void clear_msg(session* s)
+{
+        blank_win(s, s->msg);
+        refresh_win(s, s->msg);
+}
+void set_msg(session* s, char* message, int color)
+{
+        /* print a centered message in the msg window
+         */
+
+        int x_pos = floor(s->msg->width / 2) - ceil(strlen(message) / 2);
+
+        clear_msg(s);
+
+        if (x_pos < 0) {
+                message[s->msg->width] = '\0';    /* cut string */
+                x_pos = 0;
+        }
+        put_str(s, s->msg, 0, x_pos, message, color);
+        refresh_win(s, s->msg);
+}
+
+void display_shots(session* s, game_state* game)
+{
+        /* the shots in view, the first one at every cell: only the tiles
+         * of the shot index under the view are walked */
+        struct shot_buf* shots = &game->shots;
+        struct shot_iter it;
+        point shot;
+        int i;
+
+        shot_iter_start(&it, game, s->view.y, s->view.x,
+                        s->view.y + s->field->height-1,
+                        s->view.x + s->field->width-1);
+        while ((i = shot_iter_next(&it)) >= 0) {
+                shot.x = shots->x[i];
+                shot.y = shots->y[i];
+                draw_shot(s, shot, shot_color[shots->bucket[i]]);
+        }
+        refresh_win(s, s->field);
+}
+
+void draw_heatmap(session* s, mtWIN* win, game_state* game)
+{
+        /* paint every cell in view inside the border with the lamp bucket
+         * it would score: off the bucket map, or a row of the view at a
+         * time off target_row() on a field without maps
+         */
+        const unsigned int* dist = NULL;
+        const unsigned char* row = NULL;
+        int y, x, n, bucket;
+
+        n = game->width-1 - (s->view.x+1);
+        if (n > win->width-2)
+                n = win->width-2;
+        for (y=1; y<win->height-1 && n > 0; y++) {
+                if (s->view.y + y >= game->height-1)
+                        break;
+                if (game->bucket_map)
+                        row = game->bucket_map + (s->view.y + y) *
+                                game->width + s->view.x + 1;
+                else
+                        dist = target_row(game, s->view.y + y,
+                                          s->view.x + 1, n);
+                for (x=0; x<n; x++) {
+                        bucket = row ? row[x] : distance_bucket(dist[x]);
+                        put_cell(s, win, y, x+1, heat_ch[bucket],
+                                 heat_color[bucket]);
+                }
+        }
+}
+
+void draw_shot(session* s, point shot, int color)
+{
+        put_field(s, shot, '+', color);
+}
@@ -0,0 +1,140 @@
+/* (C) 2014--2015 Daniele Zanotelli
+ * dazano@gmail.com
+ *
+ * The ncurses front-end. Everything a player sees lives in a session: its
+ * own SCREEN, windows and game, so that one process can host many players
+ * at once (see server.h), each on its own terminal.
+ *
+ * A session is a state machine: session_start() greets the player, then
+ * every session_step() takes the keys typed and the ticks of its timer
+ * since the last one, goes on from where the player was (the greeting,
+ * one of the options, a game) and returns, waiting for nothing. Whoever
+ * drives it sleeps on its terminal and timer in between: session_play()
+ * for a single player, or one event loop for thousands (see server.h).
+ *
+ * ncurses is not thread safe: a session holds the ncurses lock while it
+ * steps, and lets it go in between.
+ *
+ * The field may be larger than its window, which then shows the part of it
+ * around the gunsight: only that part is ever drawn.
+ *
+ * The game screens draw through a render backend (see render.h): with
+ * session_open() a session plays on one with no terminal, fed its inputs
+ * by session_input() instead of the keys of a player.
+ *
+ * The keys come through wgetch(), or with raw_keys straight off the
+ * terminal through a key_reader (see keys.h), with no ESCDELAY waits.
+ *
+ * This software is licensed under GPL v3.
+ */
+
+#ifndef UI_H
+#define UI_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <ncurses.h>
+
+#include "engine.h"
+#include "keys.h"
+#include "replay.h"
+#include "timing.h"
+
+#define UI_FPS 60       /* the usual max_fps of a session */
+#define SESSION_OVER -2 /* see session_step() */
+
+/* where the player is, see session_step() */
+#define AT_GREET 0      /* reading the greeting */
+#define AT_NAME 1       /* the options, see ask_options() */
+#define AT_LEVEL 2
+#define AT_TIMER 3
+#define AT_READY 4      /* a key and the game starts */
+#define AT_PLAY 5
+#define AT_OVER 6       /* quit, or hung up */
+
+/* ---------------------------------------------------------------------------
+ * data structures definition
+ */
+struct grid_cell;        /* see render.h */
+struct render_ops;
+
+typedef struct
+{
+        WINDOW* win;            /* render_curses */
+        struct grid_cell* cells;        /* render_grid */
+        int y, x;
+        int height, width;
+        int border;
+} mtWIN;
+
+struct screen;          /* a reusable SCREEN, see ui.c */
+
+/* the options being asked, see ask_options() */
+struct options_form
+{
+        char name[MAX_PN_LEN+1];        /* typed so far */
+        int len;
+        int choice;             /* the level, then the timer */
+};
+
+typedef struct
+{
+        struct screen* scr;
+        int in_fd, out_fd;
+        bool closed;            /* the player hung up */
+        int at;                 /* where the player is, AT_* */
+        bool raw_keys;          /* read by keys, not by wgetch() */
+        struct key_reader keys;
+
+        const struct render_ops* render;        /* what draws, see render.h */
+        void* render_data;      /* of the backend */
+
+        bool term_colors;
+        int field_height;       /* of the games, border included: 0 for */
+        int field_width;        /* FIELD_HEIGHT x FIELD_WIDTH */
+        point view;             /* the field cell at the top left of field */
+        mtWIN* field;
+        mtWIN* panel;
+        mtWIN* lamp;
+        mtWIN* msg;
+        mtWIN* options;         /* of ask_options(), kept for every game */
+        mtWIN* greeting;        /* until the player reads it */
+        struct options_form form;
+        bool show_heatmap;      /* debug: paint the lamp buckets on the field */
+        bool show_target;       /* the target is drawn on the field */
+        bool peeked;            /* 'C' drew it, until the gunsight moves */
+        bool frame_pending;     /* windows are waiting for end_frame() */
+        int max_fps;            /* frames a second at most, 0 for no cap */
+        struct pacer pacer;     /* keeps them to max_fps */
+        struct link link;       /* holds them back if the terminal lags */
+        bool gunsight_moved;    /* since gunsight_from, not drawn yet */
+        point gunsight_from;
+
+        uint64_t seed;          /* set by the caller, see session_start() */
+        struct rng rng;         /* gives the seed of every game */
+        game_conf conf;
+        game_state game;
+        struct timer timer;     /* the countdown, or the pace of a replay */
+        bool timed;             /* the game runs on the timer */
+        bool paused;
+
+        struct replay_writer* rec;      /* the games are recorded here */
+        struct replay* replay;  /* the games are played back from here */
+        int replay_input;       /* the next one played back */
+
+        size_t heap_bytes;      /* heap taken by the terminal and the game */
+} session;
+
+/* ----------------------------------------------------------------------------
+ * functions' prototypes
+ */
+int session_input(session* s, int input);
+void session_new_game(session* s);
+void session_close(session* s);
+void session_end(session* s);
+void session_open(session* s, const struct render_ops* render);
+int session_play(session* s, const char* term, FILE* out, FILE* in);
+int session_start(session* s, const char* term, FILE* out, FILE* in);
+int session_step(session* s);
+
+#endif /* UI_H */